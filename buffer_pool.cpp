@@ -0,0 +1,146 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file buffer_pool.cpp
+ * \author Nathan Eloe
+ * \brief Implementation of the size-class buffer pool
+ */
+
+#include "buffer_pool.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <sys/mman.h>
+
+namespace zmqcpp
+{
+    const size_t BufferPool::MIN_BLOCK;
+    const size_t BufferPool::MAX_BLOCK;
+
+    BufferPool::BufferPool (const backing store, const size_t slab_size): m_backing (store), m_slab_size (slab_size)
+    {
+        for (shard &s : m_shards)
+        {
+            for (int c = 0; c < NUM_CLASSES; c++)
+                s.free[c] = nullptr;
+            s.cursor = nullptr;
+            s.remaining = 0;
+        }
+    }
+
+    BufferPool::~BufferPool()
+    {
+        for (void *slab : m_slabs)
+        {
+            if (m_backing == HUGE_PAGES)
+                munmap (slab, m_slab_size);
+            else
+                free (slab);
+        }
+    }
+
+    int BufferPool::size_class (const size_t size)
+    {
+        int cls = 0;
+        for (size_t cap = MIN_BLOCK; cap < size; cap <<= 1)
+            cls++;
+        return cls;
+    }
+
+    int BufferPool::my_shard()
+    {
+        static std::atomic<unsigned int> next (0);
+        static thread_local int mine = next++ % NUM_SHARDS;
+        return mine;
+    }
+
+    char *BufferPool::new_slab()
+    {
+        void *slab = nullptr;
+        if (m_backing == HUGE_PAGES)
+        {
+            slab = mmap (nullptr, m_slab_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (slab == MAP_FAILED)
+            {
+                // no reserved huge pages; ask for transparent ones instead
+                slab = mmap (nullptr, m_slab_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                if (slab == MAP_FAILED)
+                    throw std::bad_alloc();
+#ifdef MADV_HUGEPAGE
+                madvise (slab, m_slab_size, MADV_HUGEPAGE);
+#endif
+            }
+        }
+        else if (! (slab = malloc (m_slab_size)))
+            throw std::bad_alloc();
+        std::lock_guard<std::mutex> lock (m_slab_lock);
+        m_slabs.push_back (slab);
+        return static_cast<char *> (slab);
+    }
+
+    void *BufferPool::acquire (const size_t size)
+    {
+        if (size > MAX_BLOCK)
+        {
+            block_hdr *b = static_cast<block_hdr *> (malloc (sizeof (block_hdr) + size));
+            if (!b)
+                throw std::bad_alloc();
+            b->pool = this;
+            b->cls = OVERSIZE;
+            return b + 1;
+        }
+        const int cls = size_class (size);
+        const int sh = my_shard();
+        shard &s = m_shards[sh];
+        std::lock_guard<std::mutex> lock (s.lock);
+        block_hdr *b = s.free[cls];
+        if (b)
+        {
+            s.free[cls] = b->next;
+            return b + 1;
+        }
+        const size_t need = sizeof (block_hdr) + (MIN_BLOCK << cls);
+        if (s.remaining < need)
+        {
+            // whatever is left of the old slab is too small; it stays unused
+            s.cursor = new_slab();
+            s.remaining = m_slab_size;
+        }
+        b = reinterpret_cast<block_hdr *> (s.cursor);
+        s.cursor += need;
+        s.remaining -= need;
+        b->pool = this;
+        b->cls = cls;
+        b->shard = sh;
+        return b + 1;
+    }
+
+    void BufferPool::release (void *data, void *hint)
+    {
+        block_hdr *b = static_cast<block_hdr *> (data) - 1;
+        if (b->cls == OVERSIZE)
+        {
+            free (b);
+            return;
+        }
+        shard &s = b->pool->m_shards[b->shard];
+        std::lock_guard<std::mutex> lock (s.lock);
+        b->next = s.free[b->cls];
+        s.free[b->cls] = b;
+    }
+}
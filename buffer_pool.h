@@ -0,0 +1,128 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file buffer_pool.h
+ * \author Nathan Eloe
+ * \brief A size-class buffer pool for zmq frame payloads
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include <zmq.hpp>
+
+namespace zmqcpp
+{
+    class BufferPool
+    {
+      public:
+        enum backing
+        {
+            HEAP,       // slabs come from malloc
+            HUGE_PAGES  // slabs are mmap'd with MAP_HUGETLB (falls back to transparent huge pages)
+        };
+        // smallest and largest pooled block payloads; bigger requests go straight to malloc
+        static const size_t MIN_BLOCK = 64;
+        static const size_t MAX_BLOCK = 256 * 1024;
+
+      private:
+        static const int NUM_CLASSES = 13; // 64 B .. 256 KiB, powers of two
+        static const int NUM_SHARDS = 16;
+        static const uint16_t OVERSIZE = 0xffff;
+
+        // sits right in front of every block's payload
+        struct alignas (16) block_hdr
+        {
+            block_hdr *next;
+            BufferPool *pool;
+            uint16_t cls;
+            uint16_t shard;
+        };
+
+        // threads are spread over shards; a block always goes back to the shard it came from
+        struct alignas (64) shard
+        {
+            std::mutex lock;
+            block_hdr *free[NUM_CLASSES];
+            char *cursor;
+            size_t remaining;
+        };
+
+        backing m_backing;
+        size_t m_slab_size;
+        shard m_shards[NUM_SHARDS];
+        std::mutex m_slab_lock;
+        std::vector<void *> m_slabs;
+
+        static int size_class (const size_t size);
+        static int my_shard();
+        char *new_slab();
+
+      public:
+        /*!
+         * \brief Constructor
+         * \pre slab_size is large enough to hold a MAX_BLOCK block (and a multiple of 2 MiB for HUGE_PAGES)
+         * \post The pool is empty; slabs are reserved lazily as blocks are requested
+         */
+        BufferPool (const backing store = HEAP, const size_t slab_size = 2 * 1024 * 1024);
+        /*!
+         * \brief Destructor
+         * \pre every block acquired from this pool has been released
+         * \post all slabs are returned to the system
+         */
+        ~BufferPool();
+        BufferPool (const BufferPool &) = delete;
+        BufferPool &operator= (const BufferPool &) = delete;
+
+        /*!
+         * \brief gets a block of at least size bytes
+         * \pre None
+         * \post the block belongs to the caller until it is released
+         * \returns pointer to the block's payload
+         */
+        void *acquire (const size_t size);
+        /*!
+         * \brief returns a block to the pool it came from (zmq_free_fn compatible; safe from any thread)
+         * \pre data was returned by acquire() on a pool that is still alive
+         * \post the block may be handed out again
+         */
+        static void release (void *data, void *hint);
+        /*!
+         * \brief rebuilds msg over a pooled block of size bytes; libzmq releases it back here when done
+         * \pre None
+         * \post msg.data() points to size writable bytes (libzmq still mallocs its small refcount header for msg)
+         */
+        void build (zmq::message_t &msg, const size_t size)
+        {
+            msg.rebuild (acquire (size), size, release, nullptr);
+        }
+        /*!
+         * \brief returns what backs this pool's slabs
+         * \pre None
+         * \post None
+         * \returns HEAP or HUGE_PAGES
+         */
+        backing store() const
+        {
+            return m_backing;
+        }
+    };
+}
@@ -0,0 +1,199 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file capture.cpp
+ * \author Nathan Eloe
+ * \brief Implementation of the traffic log and its reader
+ */
+
+#include "capture.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace zmqcpp
+{
+    namespace
+    {
+        const char MAGIC[8] = {'Z', 'C', 'P', 'P', 'C', 'A', 'P', '1'};
+        const size_t FILE_HDR = 16;
+
+        struct rec_hdr
+        {
+            uint32_t len;
+            uint32_t frames;
+            uint64_t ts_ns;
+            uint32_t sock_id;
+            uint8_t dir;
+            uint8_t pad[3];
+        };
+
+        size_t pad8 (const size_t n)
+        {
+            return (n + 7) & ~ static_cast<size_t> (7);
+        }
+
+        std::runtime_error sys_error (const std::string &what)
+        {
+            return std::runtime_error (what + ": " + strerror (errno));
+        }
+    }
+
+    Capture::Capture (const std::string &path, const size_t capacity): m_cap (pad8 (capacity)), m_cursor (FILE_HDR), m_dropped (0)
+    {
+        if ((m_fd = open (path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644)) < 0)
+            throw sys_error ("open " + path);
+        void *base = MAP_FAILED;
+        // a fresh file reads as zeros, so every record not yet written already looks like the end of the log
+        if (ftruncate (m_fd, m_cap) == 0)
+            base = mmap (nullptr, m_cap, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+        if (base == MAP_FAILED)
+        {
+            close (m_fd);
+            throw sys_error ("mmap " + path);
+        }
+        m_base = static_cast<char *> (base);
+        memcpy (m_base, MAGIC, sizeof (MAGIC));
+        // the wall clock is read once; records are stamped from the steady clock, which can't step backwards
+        m_start = std::chrono::steady_clock::now();
+        m_wall_ns = std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::system_clock::now().time_since_epoch()).count();
+        memcpy (m_base + sizeof (MAGIC), &m_wall_ns, sizeof (m_wall_ns));
+    }
+
+    Capture::~Capture()
+    {
+        const uint64_t used = std::min<uint64_t> (m_cursor, m_cap);
+        munmap (m_base, m_cap);
+        // keep one empty record header after the last record so readers know where to stop
+        if (ftruncate (m_fd, std::min<uint64_t> (used + sizeof (rec_hdr), m_cap)) < 0)
+        {
+            // the untrimmed log is still readable; it is only bigger than it needs to be
+        }
+        close (m_fd);
+    }
+
+    char *Capture::reserve (const uint32_t id, const direction dir, const size_t frames, const size_t bytes, uint32_t &len)
+    {
+        const size_t need = pad8 (sizeof (rec_hdr) + frames * sizeof (uint32_t) + bytes);
+        // a record that ends exactly at the end of the mapping leaves no room for the end marker
+        const uint64_t at = m_cursor.fetch_add (need, std::memory_order_relaxed);
+        if (at + need + sizeof (rec_hdr) > m_cap || need > UINT32_MAX)
+        {
+            m_dropped++;
+            return nullptr;
+        }
+        rec_hdr *hdr = reinterpret_cast<rec_hdr *> (m_base + at);
+        hdr->frames = frames;
+        hdr->ts_ns = m_wall_ns + std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now() - m_start).count();
+        hdr->sock_id = id;
+        hdr->dir = dir;
+        len = need;
+        return reinterpret_cast<char *> (hdr + 1);
+    }
+
+    char *Capture::put_frame (char *at, const const_buffer &frame)
+    {
+        const uint32_t size = frame.size;
+        memcpy (at, &size, sizeof (size));
+        memcpy (at + sizeof (size), frame.data, frame.size);
+        return at + sizeof (size) + frame.size;
+    }
+
+    void Capture::commit (char *rec, const uint32_t len)
+    {
+        // the length goes in last, so a reader never sees a record that is only half written
+        __atomic_store_n (& (reinterpret_cast<rec_hdr *> (rec) - 1)->len, len, __ATOMIC_RELEASE);
+    }
+
+    bool Capture::record (const uint32_t id, const direction dir, const const_buffer *frames, const size_t count)
+    {
+        size_t bytes = 0;
+        for (size_t i = 0; i < count; i++)
+            bytes += frames[i].size;
+        uint32_t len;
+        char *rec = reserve (id, dir, count, bytes, len);
+        if (!rec)
+            return false;
+        char *at = rec;
+        for (size_t i = 0; i < count; i++)
+            at = put_frame (at, frames[i]);
+        commit (rec, len);
+        return true;
+    }
+
+    CaptureReader::CaptureReader (const std::string &path): m_pos (FILE_HDR)
+    {
+        const int fd = open (path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw sys_error ("open " + path);
+        struct stat st;
+        void *base = MAP_FAILED;
+        if (fstat (fd, &st) == 0 && static_cast<size_t> (st.st_size) >= FILE_HDR)
+            base = mmap (nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close (fd);
+        if (base == MAP_FAILED)
+            throw std::runtime_error ("can't map capture log " + path);
+        m_base = static_cast<char *> (base);
+        m_size = st.st_size;
+        if (memcmp (m_base, MAGIC, sizeof (MAGIC)))
+        {
+            munmap (m_base, m_size);
+            throw std::runtime_error (path + " is not a capture log");
+        }
+    }
+
+    CaptureReader::~CaptureReader()
+    {
+        munmap (m_base, m_size);
+    }
+
+    bool CaptureReader::next (capture_record &rec)
+    {
+        if (m_pos + sizeof (rec_hdr) > m_size)
+            return false;
+        const rec_hdr *hdr = reinterpret_cast<const rec_hdr *> (m_base + m_pos);
+        const uint32_t len = __atomic_load_n (&hdr->len, __ATOMIC_ACQUIRE);
+        if (!len || m_pos + len > m_size)
+            return false;
+        rec.ts_ns = hdr->ts_ns;
+        rec.sock_id = hdr->sock_id;
+        rec.dir = static_cast<direction> (hdr->dir);
+        rec.frames.clear();
+        const char *at = reinterpret_cast<const char *> (hdr + 1);
+        for (uint32_t i = 0; i < hdr->frames; i++)
+        {
+            uint32_t size;
+            memcpy (&size, at, sizeof (size));
+            rec.frames.push_back ({at + sizeof (size), size});
+            at += sizeof (size) + size;
+        }
+        m_pos += len;
+        return true;
+    }
+
+    void CaptureReader::rewind()
+    {
+        m_pos = FILE_HDR;
+    }
+}
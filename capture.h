@@ -0,0 +1,171 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file capture.h
+ * \author Nathan Eloe
+ * \brief An append-only, memory-mapped traffic log and its reader
+ *
+ * File layout (native byte order; logs are meant to be replayed on the machine type that wrote them):
+ *   header:  "ZCPPCAP1" (8 bytes), [wall clock when the log was opened, ns since the epoch: u64]
+ *   records: [len: u32][frames: u32][timestamp ns: u64][socket id: u32][direction: u8][3 pad bytes]
+ *            then for each frame [size: u32][bytes], the whole record padded to 8 bytes
+ * A record with len == 0 ends the log.
+ *
+ * Record timestamps are the opening wall-clock time plus a steady_clock offset, so they never step
+ * backwards with the system clock.  Records written by different threads at nearly the same moment may
+ * still land in the log a little out of timestamp order.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+#include "messages/frame.h"
+
+namespace zmqcpp
+{
+    enum direction : uint8_t
+    {
+        OUTBOUND = 0,
+        INBOUND = 1
+    };
+
+    class Capture
+    {
+      private:
+        int m_fd;
+        char *m_base;
+        size_t m_cap;
+        std::atomic<uint64_t> m_cursor;
+        std::atomic<uint64_t> m_dropped;
+        uint64_t m_wall_ns;
+        std::chrono::steady_clock::time_point m_start;
+
+        // claims room for a record (lock-free); nullptr if the log is full
+        char *reserve (const uint32_t id, const direction dir, const size_t frames, const size_t bytes, uint32_t &len);
+        static char *put_frame (char *at, const const_buffer &frame);
+        static void commit (char *rec, const uint32_t len);
+
+      public:
+        /*!
+         * \brief Constructor
+         * \pre None
+         * \post path is created (or truncated) and capacity bytes of it are mapped for logging
+         * \throws std::runtime_error if the file can't be created or mapped
+         */
+        Capture (const std::string &path, const size_t capacity = 1024 * 1024 * 1024);
+        /*!
+         * \brief Destructor
+         * \pre no socket is still capturing into this log
+         * \post the log is unmapped and the file trimmed to the records actually written
+         */
+        ~Capture();
+        Capture (const Capture &) = delete;
+        Capture &operator= (const Capture &) = delete;
+
+        ///@{
+        /*!
+         * \brief appends one message to the log; safe to call from several threads at once
+         * \pre None
+         * \post the message is in the log, stamped with the current time, unless the log is full
+         * \returns false (and counts a drop) if the log is full
+         */
+        bool record (const uint32_t id, const direction dir, const const_buffer *frames, const size_t count);
+        template <class It>
+        bool record (const uint32_t id, const direction dir, It first, It last);
+        ///@}
+
+        /*!
+         * \brief the number of messages that didn't fit in the log
+         * \pre None
+         * \post None
+         * \returns the drop count
+         */
+        uint64_t dropped() const
+        {
+            return m_dropped;
+        }
+    };
+
+    /*!
+     * \brief One logged message; the frames point into the reader's mapping
+     */
+    struct capture_record
+    {
+        uint64_t ts_ns;
+        uint32_t sock_id;
+        direction dir;
+        std::vector<const_buffer> frames;
+    };
+
+    class CaptureReader
+    {
+      private:
+        char *m_base;
+        size_t m_size, m_pos;
+
+      public:
+        /*!
+         * \brief Constructor
+         * \pre path is a log written by Capture
+         * \post the log is mapped read-only and positioned at its first record
+         * \throws std::runtime_error if the file can't be mapped or isn't a capture log
+         */
+        CaptureReader (const std::string &path);
+        ~CaptureReader();
+        CaptureReader (const CaptureReader &) = delete;
+        CaptureReader &operator= (const CaptureReader &) = delete;
+
+        /*!
+         * \brief reads the next record
+         * \pre None
+         * \post rec holds the record; its frame views stay valid for the reader's lifetime
+         * \returns false at the end of the log
+         */
+        bool next (capture_record &rec);
+        /*!
+         * \brief goes back to the first record
+         * \pre None
+         * \post the next call to next() returns the first record
+         */
+        void rewind();
+    };
+
+    template <class It>
+    bool Capture::record (const uint32_t id, const direction dir, It first, It last)
+    {
+        size_t frames = 0, bytes = 0;
+        for (It it = first; it != last; ++it, frames++)
+            bytes += frame_view (*it).size;
+        uint32_t len;
+        char *rec = reserve (id, dir, frames, bytes, len);
+        if (!rec)
+            return false;
+        char *at = rec;
+        for (It it = first; it != last; ++it)
+            at = put_frame (at, frame_view (*it));
+        commit (rec, len);
+        return true;
+    }
+}
@@ -26,7 +26,10 @@
 #include <memory>
 #include <string>
 #include <cstring>
+#include <zmq.hpp>
 
+#include "frame.h"
+#include "header.h"
 #include "../socket.h"
 
 namespace zmqcpp
@@ -37,6 +40,8 @@ class BaseMessage
   protected:
     friend class Socket;
     mutable std::list <std::shared_ptr<std::string>> m_frames;
+    // frame slots (and their string capacity) parked by recv_into, waiting to be refilled
+    std::list <std::shared_ptr<std::string>> m_spare;
     bool m_rstart;
     ///@{
     /*!
@@ -95,6 +100,87 @@ class BaseMessage
         as_child().end_recv();
     }
 
+    // ------- Protected functions a child MAY hide to keep routing frames apart from its body (see EnvelopeMessage)
+    /*!
+     * \brief offered every received frame before it becomes a body frame
+     * \pre None
+     * \post None
+     * \returns true if the child kept the frame (moving it out of z_msg); the default keeps nothing
+     */
+    bool take_frame (zmq::message_t &z_msg)
+    {
+        return false;
+    }
+    /*!
+     * \brief the number of routing frames Socket sends ahead of the body
+     * \pre None
+     * \post None
+     * \returns 0 by default
+     */
+    size_t hop_count() const
+    {
+        return 0;
+    }
+    /*!
+     * \brief routing frame i, in sending order
+     * \pre i < hop_count()
+     * \post None
+     * \returns the frame, which Socket zmq_msg_copy's rather than copying its bytes
+     */
+    zmq::message_t *hop (const size_t i) const
+    {
+        return nullptr;
+    }
+
+    /*!
+     * \brief Parks every frame as a spare so the next frames received can reuse them
+     * \pre None
+     * \post the frame list is empty; its old frames are at the front of the spare list
+     * \post extern frames are dropped rather than parked, so their regions are released right away
+     */
+    void recycle_frames()
+    {
+        for (auto it = m_frames.begin(); it != m_frames.end();)
+        {
+            if (std::get_deleter<extern_frame> (*it))
+                it = m_frames.erase (it);
+            else
+                ++it;
+        }
+        m_spare.splice (m_spare.begin(), m_frames);
+    }
+    /*!
+     * \brief Adds a frame to the message, reusing a spare frame slot if there is one
+     * \pre None
+     * \post the sequence of bytes is added to the frames; no allocation happens if a spare
+     *       slot is available, nobody else holds it, and its string is already big enough
+     */
+    void refill_frame (const char *bytes, const size_t size)
+    {
+        if (m_spare.empty())
+        {
+            add_frame (bytes, size);
+            return;
+        }
+        m_frames.splice (m_frames.end(), m_spare, m_spare.begin());
+        std::shared_ptr<std::string> &s = m_frames.back();
+        // someone else still looks at this string (a frames() copy, an in-flight send): leave it be
+        if (s.unique() && !std::get_deleter<extern_frame> (s))
+            s->assign (bytes, size);
+        else
+            s = std::shared_ptr<std::string> (new std::string (bytes, size));
+    }
+
+    /*!
+     * \brief Adds an already built frame (e.g. an extern frame) to the message
+     * \pre None
+     * \post frame is added to the back of the frames, without copying
+     */
+    void adopt_frame (const std::shared_ptr<std::string> &frame)
+    {
+        m_frames.push_back (frame);
+    }
+
   public:
     ///@{
     /*!
@@ -110,6 +196,13 @@ class BaseMessage
     {
         add_frame (std::string (bytes, (size == -1 ? strlen (bytes) : size)));
     }
+    template <class... Fields>
+    void add_frame (const Header<Fields...> &h)
+    {
+        std::shared_ptr<std::string> frame (new std::string());
+        h.encode (*frame);
+        m_frames.push_back (frame);
+    }
     void append (const std::string &s)
     {
         add_frame (s);
@@ -128,6 +221,19 @@ class BaseMessage
     }
     ///@}
 
+    /*!
+     * \brief Adds a frame whose bytes are mapped straight out of a file
+     * \pre None; length == 0 means "to the end of the file"
+     * \post the region is added to the frames to send; Socket::send sends it zero-copy and it is
+     *       unmapped once the message and libzmq are both done with it
+     * \post the frame's string is empty; use frame_view() to get at its bytes
+     * \throws std::runtime_error if the file can't be opened or mapped, or the range runs past its end
+     */
+    void add_file_frame (const std::string &path, const size_t offset = 0, const size_t length = 0)
+    {
+        m_frames.push_back (map_file_frame (path, offset, length));
+    }
+
     /*!
      * \brief removes the message at the front of the list
      * \pre None
@@ -177,7 +283,10 @@ class BaseMessage
      */
     std::string last()
     {
-        return (m_frames.size()) ? * (m_frames.back()) : "";
+        if (!m_frames.size())
+            return "";
+        const const_buffer b = frame_view (m_frames.back());
+        return std::string (static_cast<const char *> (b.data), b.size);
     }
     /*!
      * \brief returns the last string in the message list
@@ -187,7 +296,75 @@ class BaseMessage
      */
     std::string first()
     {
-        return (m_frames.size()) ? * (m_frames.front()) : "";
+        if (!m_frames.size())
+            return "";
+        const const_buffer b = frame_view (m_frames.front());
+        return std::string (static_cast<const char *> (b.data), b.size);
+    }
+
+    /*!
+     * \brief looks at the first frame without copying it
+     * \pre None
+     * \post None
+     * \returns a view of the first frame (valid until the frames change), or an empty view if there are none
+     */
+    const_buffer front_view() const
+    {
+        if (!m_frames.size())
+            return {nullptr, 0};
+        return frame_view (m_frames.front());
+    }
+    /*!
+     * \brief looks at frame i without copying it
+     * \pre None
+     * \post None
+     * \returns a view of frame i (valid until the frames change), or an empty view if there are no more than i frames
+     */
+    const_buffer view (const size_t i) const
+    {
+        auto it = m_frames.begin();
+        for (size_t k = 0; k < i && it != m_frames.end(); k++)
+            ++it;
+        if (it == m_frames.end())
+            return {nullptr, 0};
+        return frame_view (*it);
+    }
+
+    /*!
+     * \brief the total size of the frames
+     * \pre None
+     * \post None
+     * \returns the number of bytes the frames hold (what frame_view() sees, for extern and shared memory frames)
+     */
+    size_t bytes() const
+    {
+        size_t total = 0;
+        for (const std::shared_ptr<std::string> &f : m_frames)
+            total += frame_view (f).size;
+        return total;
+    }
+    /*!
+     * \brief appends another message's frames without copying their bytes
+     * \pre None
+     * \post this message ends with from's frames; both messages share the strings, and neither
+     *       overwrites a shared one when it is reused for a recv_into()
+     */
+    template <class U>
+    void share_frames (const BaseMessage<U> &from)
+    {
+        std::list<std::shared_ptr<std::string>> frames = from.frames();
+        m_frames.splice (m_frames.end(), frames);
+    }
+
+    /*!
+     * \brief trades frames with another message of the same type, copying none of them
+     * \pre None
+     * \post each message has the other's frames and spare frame slots (routing frames stay put)
+     */
+    void swap (BaseMessage<T> &other)
+    {
+        m_frames.swap (other.m_frames);
+        m_spare.swap (other.m_spare);
     }
 
     /*!
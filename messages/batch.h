@@ -0,0 +1,189 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file batch.h
+ * \author Nathan Eloe
+ * \brief A message carrying many independent calls as [call id][payload] frame pairs
+ *
+ * Call ids are 4-byte big-endian frames.  A routed BatchMessage (as received on a ROUTER) keeps the
+ * sender's identity frame apart from the calls and sends it back ahead of them, so a reply built with
+ * reply_to() goes back to the peer the request came from.
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <zmq.hpp>
+
+#include "_base_msg.h"
+#include "header.h"
+#include "../socket.h"
+
+namespace zmqcpp
+{
+class BatchMessage: public BaseMessage<BatchMessage>
+{
+    friend class BaseMessage<BatchMessage>;
+    friend class Socket;
+  public:
+    typedef Header<field<uint32_t>> call_id;
+
+    /*!
+     * \brief Constructor
+     * \pre None
+     * \post with routed set, the first frame received is the sender's identity rather than part of a call
+     */
+    BatchMessage (const bool routed = false): m_routed (routed), m_has_peer (false), m_taking (false) {}
+
+    ///@{
+    /*!
+     * \brief adds a call
+     * \pre None
+     * \post the message ends with [id][payload]
+     */
+    void add_call (const uint32_t id, const void *data, const size_t size)
+    {
+        add_frame (call_id (id));
+        add_frame (static_cast<const char *> (data), size);
+    }
+    void add_call (const uint32_t id, const std::string &payload)
+    {
+        add_call (id, payload.data(), payload.size());
+    }
+    ///@}
+
+    /*!
+     * \brief the number of calls
+     * \pre None
+     * \post None
+     * \returns the number of frame pairs
+     */
+    size_t calls() const
+    {
+        return m_frames.size() / 2;
+    }
+    /*!
+     * \brief walks the calls in order, without copying any payload
+     * \pre fn is callable as fn (uint32_t id, const const_buffer &payload)
+     * \post fn has seen every call, up to the first malformed one
+     * \returns false if the frames aren't all [4-byte id][payload] pairs
+     */
+    template <class F>
+    bool for_each_call (F fn) const
+    {
+        if (m_frames.size() % 2)
+            return false;
+        call_id id;
+        for (auto it = m_frames.begin(); it != m_frames.end(); ++it)
+        {
+            if (!id.decode (*it))
+                return false;
+            ++it;
+            fn (id.get<0>(), frame_view (*it));
+        }
+        return true;
+    }
+
+    /*!
+     * \brief addresses this message to whoever sent req
+     * \pre req was received routed
+     * \post this message will be sent back to req's sender (the identity frame is shared, not copied)
+     */
+    void reply_to (const BatchMessage &req)
+    {
+        m_peer.copy (&req.m_peer);
+        m_has_peer = req.m_has_peer;
+    }
+
+  protected:
+    /*!
+     * \brief prepares the frames to be sent
+     * \pre None
+     * \post None
+     * \returns the call frames (Socket sends the identity, if any, ahead of them)
+     */
+    const std::list <std::shared_ptr<std::string>> &prep_frames() const
+    {
+        return m_frames;
+    }
+    /*!
+     * \brief cleans up after sending the frames
+     * \pre None
+     * \post None
+     */
+    void unprep_frames() const
+    {
+        return;
+    }
+    /*!
+     * \brief Prepares to receive
+     * \pre None
+     * \post a routed message will take the next frame as its sender's identity
+     */
+    void start_recv()
+    {
+        m_has_peer = false;
+        m_taking = m_routed;
+    }
+    /*!
+     * \brief signifies the end of recv
+     * \pre None
+     * \post None
+     */
+    void end_recv()
+    {
+        m_taking = false;
+    }
+    /*!
+     * \brief keeps the identity frame of a routed message
+     * \pre None
+     * \post the first frame of a routed message has been moved (not copied) out of z_msg
+     * \returns true if the frame was kept
+     */
+    bool take_frame (zmq::message_t &z_msg)
+    {
+        if (!m_taking)
+            return false;
+        m_peer.move (&z_msg);
+        m_has_peer = true;
+        m_taking = false;
+        return true;
+    }
+    ///@{
+    /*!
+     * \brief the identity frame, sent ahead of the calls
+     * \pre i < hop_count()
+     * \post None
+     * \returns the identity frame
+     */
+    size_t hop_count() const
+    {
+        return m_has_peer ? 1 : 0;
+    }
+    zmq::message_t *hop (const size_t) const
+    {
+        return &m_peer;
+    }
+    ///@}
+
+  private:
+    bool m_routed, m_has_peer, m_taking;
+    // zmq_msg_copy needs a non-const source, hence mutable
+    mutable zmq::message_t m_peer;
+};
+}
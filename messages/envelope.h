@@ -0,0 +1,230 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file envelope.h
+ * \author Nathan Eloe
+ * \brief A message that keeps its ROUTER/DEALER routing envelope apart from the body
+ *
+ * The envelope frames (identities, and the empty delimiter if there is one) are kept as the zmq
+ * messages they arrived in, on a small inline stack with the outermost hop on top.  Receiving moves
+ * them in without copying, stripping or pushing a hop is O(1), and sending hands libzmq a zmq_msg_copy
+ * of each, which for identity-sized frames is just the few bytes libzmq keeps inline.
+ */
+#pragma once
+
+#include <cstring>
+#include <deque>
+#include <string>
+#include <zmq.hpp>
+
+#include "_base_msg.h"
+#include "../socket.h"
+
+namespace zmqcpp
+{
+class EnvelopeMessage: public BaseMessage<EnvelopeMessage>
+{
+    friend class BaseMessage<EnvelopeMessage>;
+    friend class Socket;
+  public:
+    // hops kept inside the message itself; deeper envelopes spill into m_more
+    static const size_t INLINE_HOPS = 8;
+
+    /*!
+     * \brief Constructor
+     * \pre None
+     * \post with id_frames == 0, received frames up to and including the first empty one are the envelope
+     *       (REQ/REP style); otherwise the first id_frames frames are (e.g. 1 for DEALER peers of a ROUTER)
+     */
+    EnvelopeMessage (const size_t id_frames = 0): m_fixed (id_frames), m_hops (0), m_open (false) {}
+
+    /*!
+     * \brief the number of routing frames
+     * \pre None
+     * \post None
+     * \returns the envelope depth
+     */
+    size_t hops() const
+    {
+        return m_hops;
+    }
+    /*!
+     * \brief looks at a routing frame
+     * \pre i < hops()
+     * \post None
+     * \returns a view of hop i (0 is the outermost, the one sent first)
+     */
+    const_buffer hop_view (const size_t i) const
+    {
+        zmq::message_t &h = slot (m_hops - 1 - i);
+        return {h.data(), h.size()};
+    }
+    ///@{
+    /*!
+     * \brief pushes a new outermost routing frame (e.g. the worker a broker forwards to)
+     * \pre None
+     * \post the frame is hop 0; identity-sized frames don't allocate
+     */
+    void push_hop (const void *data, const size_t size)
+    {
+        zmq::message_t &h = slot (m_hops++);
+        h.rebuild (size);
+        memcpy (h.data(), data, size);
+    }
+    void push_hop (const std::string &id)
+    {
+        push_hop (id.data(), id.size());
+    }
+    ///@}
+    /*!
+     * \brief strips the outermost routing frame
+     * \pre None
+     * \post hop 1 (if any) is now hop 0
+     */
+    void pop_hop()
+    {
+        if (m_hops)
+            slot (--m_hops).rebuild();
+    }
+    /*!
+     * \brief replaces this envelope with another message's (e.g. to address a reply to a request's sender)
+     * \pre None
+     * \post this message has from's hops; the frames are shared with from, not copied
+     */
+    void copy_envelope (const EnvelopeMessage &from)
+    {
+        clear_envelope();
+        for (size_t p = 0; p < from.m_hops; p++)
+            slot (p).copy (&from.slot (p));
+        m_hops = from.m_hops;
+    }
+    /*!
+     * \brief drops every routing frame
+     * \pre None
+     * \post hops() == 0
+     */
+    void clear_envelope()
+    {
+        while (m_hops)
+            pop_hop();
+    }
+
+  protected:
+    /*!
+     * \brief prepares the frames to be sent (the body; Socket sends the hops ahead of it)
+     * \pre None
+     * \post None
+     * \returns the body frames
+     */
+    const std::list <std::shared_ptr<std::string>> &prep_frames() const
+    {
+        return m_frames;
+    }
+    /*!
+     * \brief cleans up after sending the frames
+     * \pre None
+     * \post None
+     */
+    void unprep_frames() const
+    {
+        return;
+    }
+    /*!
+     * \brief Prepares to receive
+     * \pre None
+     * \post the old envelope is dropped; the next frames received go to the envelope until it is complete
+     */
+    void start_recv()
+    {
+        clear_envelope();
+        m_open = true;
+    }
+    /*!
+     * \brief signifies the end of recv
+     * \pre None
+     * \post in delimiter mode, a message that never had an empty frame has no envelope: its frames become the body
+     */
+    void end_recv()
+    {
+        if (!m_open)
+            return;
+        m_open = false;
+        for (size_t p = 0; p < m_hops; p++)
+            add_frame (static_cast<char *> (slot (p).data()), slot (p).size());
+        clear_envelope();
+    }
+    /*!
+     * \brief keeps a received frame as a hop while the envelope is still open
+     * \pre None
+     * \post if the frame belongs to the envelope, it has been moved (not copied) out of z_msg
+     * \returns true if the frame was kept
+     */
+    bool take_frame (zmq::message_t &z_msg)
+    {
+        if (!m_open)
+            return false;
+        zmq::message_t &h = slot (m_hops++);
+        h.move (&z_msg);
+        if ((m_fixed && m_hops == m_fixed) || (!m_fixed && !h.size()))
+        {
+            m_open = false;
+            // frames arrive outermost first, but the outermost hop belongs on top of the stack
+            for (size_t lo = 0, hi = m_hops - 1; lo < hi; lo++, hi--)
+            {
+                m_tmp.move (&slot (lo));
+                slot (lo).move (&slot (hi));
+                slot (hi).move (&m_tmp);
+            }
+        }
+        return true;
+    }
+    ///@{
+    /*!
+     * \brief the routing frames, in the order Socket sends them
+     * \pre i < hop_count()
+     * \post None
+     * \returns hop i (0 is the outermost)
+     */
+    size_t hop_count() const
+    {
+        return m_hops;
+    }
+    zmq::message_t *hop (const size_t i) const
+    {
+        return &slot (m_hops - 1 - i);
+    }
+    ///@}
+
+  private:
+    size_t m_fixed, m_hops;
+    bool m_open;
+    // stack of hops, bottom (innermost) first; zmq_msg_copy needs a non-const source, hence mutable
+    mutable zmq::message_t m_inline[INLINE_HOPS];
+    mutable std::deque<zmq::message_t> m_more;
+    zmq::message_t m_tmp;
+
+    zmq::message_t &slot (const size_t p) const
+    {
+        if (p < INLINE_HOPS)
+            return m_inline[p];
+        while (m_more.size() <= p - INLINE_HOPS)
+            m_more.emplace_back();
+        return m_more[p - INLINE_HOPS];
+    }
+};
+}
@@ -0,0 +1,86 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file frame.cpp
+ * \author Nathan Eloe
+ * \brief Implementation of file-backed frames
+ */
+
+#include "frame.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace zmqcpp
+{
+    namespace
+    {
+        void unmap (void *base, size_t len, void *hint)
+        {
+            munmap (base, len);
+        }
+    }
+
+    std::shared_ptr<std::string> map_file_frame (const std::string &path, const size_t offset, size_t length)
+    {
+        const int fd = open (path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error ("open " + path + ": " + strerror (errno));
+        struct stat st;
+        if (fstat (fd, &st) < 0)
+        {
+            const int err = errno;
+            close (fd);
+            throw std::runtime_error ("stat " + path + ": " + strerror (err));
+        }
+        // pages past the end of the file can be mapped, but touching them raises SIGBUS
+        const size_t file_size = st.st_size;
+        if (offset > file_size || length > file_size - offset)
+        {
+            close (fd);
+            throw std::runtime_error ("map " + path + ": range " + std::to_string (offset) + "+" + std::to_string (length) +
+                                      " is past the end of the file (" + std::to_string (file_size) + " bytes)");
+        }
+        if (!length)
+            length = file_size - offset;
+        extern_frame x = {nullptr, length, nullptr, 0, nullptr, nullptr};
+        if (length)
+        {
+            // mappings have to start on a page boundary
+            const size_t page = sysconf (_SC_PAGESIZE);
+            const size_t skew = offset % page;
+            x.len = length + skew;
+            x.base = mmap (nullptr, x.len, PROT_READ, MAP_SHARED, fd, offset - skew);
+            if (x.base == MAP_FAILED)
+            {
+                const int err = errno;
+                close (fd);
+                throw std::runtime_error ("mmap " + path + ": " + strerror (err));
+            }
+            x.data = static_cast<char *> (x.base) + skew;
+            x.release = unmap;
+        }
+        // the mapping keeps the file contents reachable on its own
+        close (fd);
+        return std::shared_ptr<std::string> (new std::string(), x);
+    }
+}
@@ -0,0 +1,103 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file frame.h
+ * \author Nathan Eloe
+ * \brief Views over frame bytes, and frames whose bytes live outside their string
+ */
+
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace zmqcpp
+{
+    /*!
+     * \brief A non-owning view over a frame's bytes
+     */
+    struct const_buffer
+    {
+        const void *data;
+        size_t size;
+    };
+
+    ///@{
+    /*!
+     * \brief builds a const_buffer over existing memory
+     * \pre the memory outlives every use of the returned view
+     * \post None
+     * \returns the view over the bytes
+     */
+    inline const_buffer buffer (const void *data, const size_t size)
+    {
+        return {data, size};
+    }
+    inline const_buffer buffer (const std::string &s)
+    {
+        return {s.data(), s.size()};
+    }
+    ///@}
+
+    /*!
+     * \brief Deleter of a frame whose bytes live somewhere else (a mapped file region, shared memory...)
+     *
+     * Such a frame is an empty std::string owned by a shared_ptr with this deleter; the region is
+     * released together with the last reference, so anything holding the frame (including an
+     * in-flight zero-copy send) keeps the region alive.
+     */
+    struct extern_frame
+    {
+        const char *data;
+        size_t size;
+        // what to hand back to release once the frame is gone
+        void *base;
+        size_t len;
+        void *hint;
+        void (*release) (void *base, size_t len, void *hint);
+
+        void operator() (std::string *s) const
+        {
+            delete s;
+            if (release)
+                release (base, len, hint);
+        }
+    };
+
+    /*!
+     * \brief gets the bytes of a frame, wherever they live
+     * \pre None
+     * \post None
+     * \returns a view of the region for extern frames, of the string otherwise
+     */
+    inline const_buffer frame_view (const std::shared_ptr<std::string> &frame)
+    {
+        if (const extern_frame *x = std::get_deleter<extern_frame> (frame))
+            return {x->data, x->size};
+        return {frame->data(), frame->size()};
+    }
+
+    /*!
+     * \brief maps length bytes of a file starting at offset, read-only
+     * \pre None; length == 0 means "to the end of the file"
+     * \post None
+     * \returns an extern frame over the mapped range; the mapping goes away with the last reference
+     * \throws std::runtime_error if the file can't be opened or mapped, or the range runs past its end
+     */
+    std::shared_ptr<std::string> map_file_frame (const std::string &path, const size_t offset = 0, size_t length = 0);
+}
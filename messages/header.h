@@ -0,0 +1,231 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file header.h
+ * \author Nathan Eloe
+ * \brief Fixed-layout binary frame headers described by a compile-time schema
+ *
+ * Header<field<uint8_t>, field<uint16_t, 2, LSB_FIRST>, field<int64_t, 6>> is a 9-byte frame: a byte,
+ * a little-endian 16-bit value and a big-endian 48-bit signed value.  Every width, offset and byte
+ * order is a template constant and the byte shuffling is unrolled by template recursion, so encode()
+ * and decode() compile to straight-line loads, shifts and stores (often a single bswap per field).
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <type_traits>
+
+#include "frame.h"
+
+namespace zmqcpp
+{
+    enum byte_order
+    {
+        MSB_FIRST,  // big-endian (network order)
+        LSB_FIRST   // little-endian
+    };
+
+    /*!
+     * \brief One header field: a T stored in Bytes bytes with the given byte order
+     */
+    template <class T, size_t Bytes = sizeof (T), byte_order Order = MSB_FIRST>
+    struct field
+    {
+        static_assert (std::is_integral<T>::value || std::is_enum<T>::value, "header fields are integers or enums");
+        static_assert (Bytes > 0 && Bytes <= sizeof (T) && Bytes <= 8, "a field is 1 to sizeof(T) bytes wide");
+        typedef T type;
+        static const size_t bytes = Bytes;
+        static const byte_order order = Order;
+    };
+
+    template <class... Fields>
+    class Header
+    {
+      private:
+        // offset and type of field I
+        template <size_t I, class F, class... Rest>
+        struct layout
+        {
+            static const size_t offset = F::bytes + layout<I - 1, Rest...>::offset;
+            typedef typename layout<I - 1, Rest...>::field field;
+        };
+        template <class F, class... Rest>
+        struct layout<0, F, Rest...>
+        {
+            static const size_t offset = 0;
+            typedef F field;
+        };
+        typedef layout<sizeof... (Fields) - 1, Fields...> last;
+
+      public:
+        typedef std::tuple<typename Fields::type...> values;
+        template <size_t I> using field_type = typename std::tuple_element<I, values>::type;
+        static const size_t N = sizeof... (Fields);
+        static const size_t SIZE = last::offset + last::field::bytes;
+
+      private:
+        values m_vals;
+
+        // byte K of a Bytes-wide field, unrolled by recursion so there is no loop left to run
+        template <size_t Bytes, byte_order Order, size_t K = 0>
+        struct bytes_io
+        {
+            static const size_t AT = (Order == MSB_FIRST) ? Bytes - 1 - K : K;
+            static void store (unsigned char *out, const uint64_t v)
+            {
+                out[AT] = static_cast<unsigned char> (v >> (8 * K));
+                bytes_io<Bytes, Order, K + 1>::store (out, v);
+            }
+            static uint64_t load (const unsigned char *in)
+            {
+                return (static_cast<uint64_t> (in[AT]) << (8 * K)) | bytes_io<Bytes, Order, K + 1>::load (in);
+            }
+        };
+        template <size_t Bytes, byte_order Order>
+        struct bytes_io<Bytes, Order, Bytes>
+        {
+            static void store (unsigned char *, const uint64_t) {}
+            static uint64_t load (const unsigned char *)
+            {
+                return 0;
+            }
+        };
+
+        void encode_from (unsigned char *, std::integral_constant<size_t, N>) const {}
+        template <size_t I>
+        void encode_from (unsigned char *out, std::integral_constant<size_t, I>) const
+        {
+            typedef typename layout<I, Fields...>::field F;
+            bytes_io<F::bytes, F::order>::store (out + layout<I, Fields...>::offset, static_cast<uint64_t> (std::get<I> (m_vals)));
+            encode_from (out, std::integral_constant<size_t, I + 1>());
+        }
+
+        void decode_from (const unsigned char *, std::integral_constant<size_t, N>) {}
+        template <size_t I>
+        void decode_from (const unsigned char *in, std::integral_constant<size_t, I>)
+        {
+            typedef typename layout<I, Fields...>::field F;
+            uint64_t v = bytes_io<F::bytes, F::order>::load (in + layout<I, Fields...>::offset);
+            // narrow signed fields get their sign bit stretched back out (a no-op for full-width ones)
+            const uint64_t sign = std::is_signed<typename F::type>::value ? (1ull << (8 * F::bytes - 1)) : 0;
+            v = (v ^ sign) - sign;
+            std::get<I> (m_vals) = static_cast<typename F::type> (v);
+            decode_from (in, std::integral_constant<size_t, I + 1>());
+        }
+
+      public:
+        /*!
+         * \brief Default constructor
+         * \pre None
+         * \post every field is zero
+         */
+        Header(): m_vals() {}
+        /*!
+         * \brief Construction from field values
+         * \pre None
+         * \post field I holds the Ith value
+         */
+        Header (const typename Fields::type &... vals): m_vals (vals...) {}
+
+        ///@{
+        /*!
+         * \brief field I's value
+         * \pre None
+         * \post None
+         * \returns the value
+         */
+        template <size_t I>
+        const field_type<I> &get() const
+        {
+            return std::get<I> (m_vals);
+        }
+        template <size_t I>
+        field_type<I> &get()
+        {
+            return std::get<I> (m_vals);
+        }
+        ///@}
+        /*!
+         * \brief sets field I
+         * \pre None
+         * \post field I holds val (truncated to the field's width on encode)
+         */
+        template <size_t I>
+        void set (const field_type<I> &val)
+        {
+            std::get<I> (m_vals) = val;
+        }
+
+        ///@{
+        /*!
+         * \brief writes the header's SIZE bytes
+         * \pre out has room for SIZE bytes
+         * \post out holds the encoded header (the string overload reuses out's capacity)
+         */
+        void encode (void *out) const
+        {
+            encode_from (static_cast<unsigned char *> (out), std::integral_constant<size_t, 0>());
+        }
+        void encode (std::string &out) const
+        {
+            out.resize (SIZE);
+            encode (&out[0]);
+        }
+        std::string encode() const
+        {
+            std::string out;
+            encode (out);
+            return out;
+        }
+        ///@}
+
+        ///@{
+        /*!
+         * \brief reads the fields out of an encoded header
+         * \pre None
+         * \post on success, every field holds its decoded value
+         * \returns false (leaving the fields alone) if size isn't exactly SIZE
+         */
+        bool decode (const void *data, const size_t size)
+        {
+            if (size != SIZE)
+                return false;
+            decode_from (static_cast<const unsigned char *> (data), std::integral_constant<size_t, 0>());
+            return true;
+        }
+        bool decode (const const_buffer &frame)
+        {
+            return decode (frame.data, frame.size);
+        }
+        bool decode (const std::shared_ptr<std::string> &frame)
+        {
+            return decode (frame_view (frame));
+        }
+        ///@}
+    };
+
+    template <class... Fields>
+    const size_t Header<Fields...>::N;
+    template <class... Fields>
+    const size_t Header<Fields...>::SIZE;
+}
@@ -0,0 +1,257 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file typed_message.h
+ * \author Nathan Eloe
+ * \brief A fixed-arity message whose frames have declared C++ types
+ *
+ * TypedMessage<Header, Payload, Trailer> always has exactly three frames.  Each frame is kept encoded
+ * in an std::array of strings and decoded on the first get<I>() through codec<T>, which is picked at
+ * compile time: strings are taken as-is, arithmetic types are copied bytewise (native byte order), and
+ * anything else goes through a stringstream like Message does.  Specialize codec for your own types.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <type_traits>
+
+#include "frame.h"
+#include "header.h"
+#include "../socket.h"
+
+namespace zmqcpp
+{
+    class codec_error : public std::exception
+    {
+      public:
+        const char *what()
+        {
+            return "Frame could not be decoded as its declared type";
+        }
+    };
+
+    /*!
+     * \brief Turns a value into frame bytes and back; the default goes through a stringstream
+     */
+    template <class T, class Enable = void>
+    struct codec
+    {
+        static void encode (const T &val, std::string &out)
+        {
+            std::ostringstream ss;
+            ss << val;
+            out = ss.str();
+        }
+        static bool decode (const char *data, const size_t size, T &val)
+        {
+            std::istringstream ss (std::string (data, size));
+            ss >> val;
+            return !ss.fail();
+        }
+    };
+
+    template <>
+    struct codec<std::string>
+    {
+        static void encode (const std::string &val, std::string &out)
+        {
+            out.assign (val);
+        }
+        static bool decode (const char *data, const size_t size, std::string &val)
+        {
+            val.assign (data, size);
+            return true;
+        }
+    };
+
+    template <class T>
+    struct codec<T, typename std::enable_if<std::is_arithmetic<T>::value>::type>
+    {
+        static void encode (const T &val, std::string &out)
+        {
+            out.assign (reinterpret_cast<const char *> (&val), sizeof (T));
+        }
+        static bool decode (const char *data, const size_t size, T &val)
+        {
+            if (size != sizeof (T))
+                return false;
+            memcpy (&val, data, sizeof (T));
+            return true;
+        }
+    };
+
+    template <class... Fields>
+    struct codec<Header<Fields...>>
+    {
+        static void encode (const Header<Fields...> &val, std::string &out)
+        {
+            val.encode (out);
+        }
+        static bool decode (const char *data, const size_t size, Header<Fields...> &val)
+        {
+            return val.decode (data, size);
+        }
+    };
+
+    template <class... Frames>
+    class TypedMessage
+    {
+      public:
+        static const size_t N = sizeof... (Frames);
+        typedef std::tuple<Frames...> values;
+        template <size_t I> using frame_type = typename std::tuple_element<I, values>::type;
+
+      private:
+        static_assert (N > 0 && N <= 32, "a TypedMessage has between 1 and 32 frames");
+        std::array<std::string, N> m_raw;
+        mutable values m_vals;
+        // bit I is set once frame I has been decoded into m_vals (or set from a value)
+        mutable uint32_t m_decoded;
+
+        template <size_t I>
+        void assign() {}
+        template <size_t I, class V, class... Rest>
+        void assign (const V &val, const Rest &... rest)
+        {
+            set<I> (val);
+            assign<I + 1> (rest...);
+        }
+
+      public:
+        /*!
+         * \brief Default constructor
+         * \pre None
+         * \post every frame is empty
+         */
+        TypedMessage(): m_decoded (0) {}
+        /*!
+         * \brief Construction from values
+         * \pre None
+         * \post frame I holds the encoding of the Ith value
+         */
+        TypedMessage (const Frames &... vals): m_decoded (0)
+        {
+            assign<0> (vals...);
+        }
+
+        /*!
+         * \brief the value of frame I, decoded on first access
+         * \pre None
+         * \post the decoded value is cached until the frame changes
+         * \returns the value
+         * \throws codec_error if the frame doesn't decode as frame_type<I>
+         */
+        template <size_t I>
+        const frame_type<I> &get() const
+        {
+            static_assert (I < N, "frame index out of range");
+            if (! (m_decoded & (1u << I)))
+            {
+                if (!codec<frame_type<I>>::decode (m_raw[I].data(), m_raw[I].size(), std::get<I> (m_vals)))
+                    throw codec_error();
+                m_decoded |= 1u << I;
+            }
+            return std::get<I> (m_vals);
+        }
+        /*!
+         * \brief sets frame I
+         * \pre None
+         * \post frame I holds the encoding of val
+         */
+        template <size_t I>
+        void set (const frame_type<I> &val)
+        {
+            static_assert (I < N, "frame index out of range");
+            codec<frame_type<I>>::encode (val, m_raw[I]);
+            std::get<I> (m_vals) = val;
+            m_decoded |= 1u << I;
+        }
+        /*!
+         * \brief the encoded bytes of frame I
+         * \pre None
+         * \post None
+         * \returns the frame
+         */
+        template <size_t I>
+        const std::string &raw() const
+        {
+            static_assert (I < N, "frame index out of range");
+            return m_raw[I];
+        }
+
+        /*!
+         * \brief sends the frames as one message (see Socket::sendv())
+         * \pre The type of sock must be allowed to send
+         * \post the message is sent (or queued in sock's outbox)
+         * \returns Whether the message was sent or queued
+         */
+        bool send (Socket &sock, const int opts = 0) const
+        {
+            std::array<const_buffer, N> bufs;
+            for (size_t i = 0; i < N; i++)
+                bufs[i] = buffer (m_raw[i]);
+            return sock.sendv (bufs.data(), N, opts);
+        }
+        /*!
+         * \brief receives one message into the frames, reusing their string capacity
+         * \pre The type of sock must be allowed to recv
+         * \post the whole message has been read from sock; cached values are dropped
+         * \returns false if the recv failed or the message didn't have exactly N frames (its frames are discarded)
+         */
+        bool recv (Socket &sock, const int opts = 0)
+        {
+            size_t count = 0;
+            m_decoded = 0;
+            const bool win = sock.recv_frames ([this, &count] (const const_buffer & f, bool more) -> frame_act
+            {
+                if (count == N)
+                {
+                    count++;
+                    return FRAME_SKIP;
+                }
+                m_raw[count++].assign (static_cast<const char *> (f.data), f.size);
+                return FRAME_NEXT;
+            }, opts);
+            return win && count == N;
+        }
+    };
+
+    template <class... Frames>
+    const size_t TypedMessage<Frames...>::N;
+
+    template <class... Frames>
+    Socket &operator << (Socket &sock, const TypedMessage<Frames...> &msg)
+    {
+        msg.send (sock);
+        return sock;
+    }
+
+    template <class... Frames>
+    Socket &operator >> (Socket &sock, TypedMessage<Frames...> &msg)
+    {
+        msg.recv (sock);
+        return sock;
+    }
+}
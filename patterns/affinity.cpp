@@ -0,0 +1,91 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file affinity.cpp
+ * \author Nathan Eloe
+ * \brief Implementation of the rendezvous-hashing broker
+ */
+
+#include "affinity.h"
+
+namespace zmqcpp
+{
+    namespace
+    {
+        // FNV-1a
+        uint64_t hash_bytes (const void *data, const size_t size)
+        {
+            const unsigned char *p = static_cast<const unsigned char *> (data);
+            uint64_t h = 14695981039346656037ull;
+            for (size_t i = 0; i < size; i++)
+                h = (h ^ p[i]) * 1099511628211ull;
+            return h;
+        }
+        // splitmix64's finalizer: spreads the combined hashes so every bit counts in the comparison
+        uint64_t mix (uint64_t x)
+        {
+            x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+            x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+            return x ^ (x >> 31);
+        }
+        // the best-scoring worker for a key hash, skipping any at the limit (0: no limit)
+        size_t rendezvous (const std::vector<LoadBalancer::worker> &workers, const uint64_t key, const uint32_t limit)
+        {
+            size_t best = LoadBalancer::NO_WORKER;
+            uint64_t top = 0;
+            for (size_t i = 0; i < workers.size(); i++)
+            {
+                if (limit && workers[i].outstanding >= limit)
+                    continue;
+                const uint64_t score = mix (key ^ hash_bytes (workers[i].id.data(), workers[i].id.size()));
+                if (best == LoadBalancer::NO_WORKER || score > top)
+                {
+                    best = i;
+                    top = score;
+                }
+            }
+            return best;
+        }
+    }
+
+    AffinityRouter::AffinityRouter (const std::string &frontend, const std::string &backend, const size_t key_frame,
+                                    const std::chrono::milliseconds expiry, const uint32_t max_inflight):
+        LoadBalancer (frontend, backend, expiry, max_inflight), m_key_frame (key_frame), m_sticky (0), m_spilled (0) {}
+
+    size_t AffinityRouter::select (const EnvelopeMessage &req)
+    {
+        const const_buffer key = req.view (m_key_frame);
+        if (!key.data)
+            return least_outstanding();
+        const uint64_t h = hash_bytes (key.data, key.size);
+        const size_t owner = rendezvous (m_workers, h, 0);
+        if (!m_max_inflight || m_workers[owner].outstanding < m_max_inflight)
+        {
+            m_sticky++;
+            return owner;
+        }
+        m_spilled++;
+        return rendezvous (m_workers, h, m_max_inflight);
+    }
+
+    std::string AffinityRouter::owner (const std::string &key) const
+    {
+        const size_t w = rendezvous (m_workers, hash_bytes (key.data(), key.size()), 0);
+        return w == NO_WORKER ? std::string() : m_workers[w].id;
+    }
+}
@@ -0,0 +1,86 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file affinity.h
+ * \author Nathan Eloe
+ * \brief A broker that sends every request with the same key to the same worker
+ *
+ * AffinityRouter is a LoadBalancer whose select() uses rendezvous (highest random weight) hashing:
+ * each worker scores hash (key, worker id) and the highest score wins.  A worker joining only takes
+ * the keys it now outscores everyone on, and a worker leaving only hands its own keys on, so worker-side
+ * caches stay warm through membership changes.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include "load_balancer.h"
+
+namespace zmqcpp
+{
+    class AffinityRouter: public LoadBalancer
+    {
+      private:
+        size_t m_key_frame;
+        uint64_t m_sticky, m_spilled;
+
+      protected:
+        /*!
+         * \brief the top-scoring worker for the request's key
+         * \pre m_workers isn't empty
+         * \post None
+         * \returns the worker's index; with an in-flight limit, a full worker's keys go to the next-highest
+         *          scorer with room; a request without a key frame goes to the least busy worker
+         */
+        size_t select (const EnvelopeMessage &req);
+
+      public:
+        /*!
+         * \brief Constructor
+         * \pre None
+         * \post as for LoadBalancer; requests are routed by body frame key_frame (0 is the first frame after the envelope)
+         */
+        AffinityRouter (const std::string &frontend, const std::string &backend, const size_t key_frame = 0,
+                        const std::chrono::milliseconds expiry = std::chrono::milliseconds (3000), const uint32_t max_inflight = 0);
+
+        /*!
+         * \brief the worker a key maps to right now
+         * \pre None
+         * \post None
+         * \returns the worker's id, or "" if there are no workers
+         */
+        std::string owner (const std::string &key) const;
+
+        /*!
+         * \brief counters: requests that went to their key's owner, and those that spilled over to the
+         *        next worker because the owner was at its in-flight limit
+         * \pre None
+         * \post None
+         * \returns the count
+         */
+        uint64_t sticky() const
+        {
+            return m_sticky;
+        }
+        uint64_t spilled() const
+        {
+            return m_spilled;
+        }
+    };
+}
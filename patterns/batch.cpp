@@ -0,0 +1,302 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file batch.cpp
+ * \author Nathan Eloe
+ * \brief Implementation of the batching RPC client and server
+ */
+
+#include "batch.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace zmqcpp
+{
+    BatchClient::BatchClient (const std::string &endpt, const size_t max_calls, const std::chrono::microseconds window,
+                              const std::chrono::milliseconds timeout):
+        m_endpt (endpt), m_max_calls (max_calls), m_window (window), m_timeout (timeout), m_next_id (0), m_stop (false)
+    {
+        if ((m_wake_fd = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0)
+            throw std::runtime_error (std::string ("eventfd: ") + strerror (errno));
+        m_io = std::thread (&BatchClient::run, this);
+    }
+
+    BatchClient::~BatchClient()
+    {
+        m_stop = true;
+        wake();
+        m_io.join();
+        close (m_wake_fd);
+    }
+
+    std::future<std::string> BatchClient::call (const std::string &payload)
+    {
+        bool poke;
+        std::future<std::string> f;
+        {
+            std::lock_guard<std::mutex> lock (m_lock);
+            if (m_queue.empty())
+                m_first_at = clock::now();
+            m_queue.push_back ({m_next_id++, payload, std::promise<std::string>()});
+            f = m_queue.back().result.get_future();
+            // the I/O thread only needs a nudge to start a window's clock, or when the batch fills
+            poke = m_queue.size() == 1 || m_queue.size() == m_max_calls;
+        }
+        if (poke)
+            wake();
+        return f;
+    }
+
+    void BatchClient::wake()
+    {
+        const uint64_t one = 1;
+        // the counter can only fail to take this if it is already nonzero, and then the I/O thread is awake anyway
+        if (write (m_wake_fd, &one, sizeof (one)) < 0)
+            return;
+    }
+
+    void BatchClient::flush (Socket &sock)
+    {
+        std::vector<pending_call> calls;
+        {
+            std::lock_guard<std::mutex> lock (m_lock);
+            calls.swap (m_queue);
+        }
+        if (calls.empty())
+            return;
+        BatchMessage req;
+        for (const pending_call &c : calls)
+            req.add_call (c.id, c.payload);
+        // blocking here at the high-water mark would stop replies being read and timeouts from firing
+        if (!sock.send (req, ZMQ_DONTWAIT))
+        {
+            for (pending_call &c : calls)
+                c.result.set_exception (std::make_exception_ptr (std::runtime_error ("batch could not be sent")));
+            return;
+        }
+        batch b;
+        b.deadline = clock::now() + m_timeout;
+        for (pending_call &c : calls)
+        {
+            b.ids.push_back (c.id);
+            m_waiting.emplace (c.id, std::move (c.result));
+        }
+        m_batches.push_back (std::move (b));
+    }
+
+    void BatchClient::expire()
+    {
+        const clock::time_point now = clock::now();
+        while (m_batches.size() && m_batches.front().deadline <= now)
+        {
+            for (const uint32_t id : m_batches.front().ids)
+            {
+                auto it = m_waiting.find (id);
+                if (it == m_waiting.end())
+                    continue;
+                it->second.set_exception (std::make_exception_ptr (std::runtime_error ("batch call timed out")));
+                m_waiting.erase (it);
+            }
+            m_batches.pop_front();
+        }
+    }
+
+    void BatchClient::run()
+    {
+        Socket sock (ZMQ_DEALER);
+        sock.connect (m_endpt);
+        sock._conn();
+        BatchMessage rep;
+        while (!m_stop)
+        {
+            // sleep until the window closes, the oldest batch times out, or someone pokes us
+            long wait = -1;
+            {
+                std::lock_guard<std::mutex> lock (m_lock);
+                if (m_queue.size())
+                {
+                    const clock::time_point due = m_first_at + m_window;
+                    wait = std::max<long> (0, (std::chrono::duration_cast<std::chrono::microseconds> (due - clock::now()).count() + 999) / 1000);
+                }
+            }
+            if (m_batches.size())
+            {
+                const long left = std::max<long> (0, std::chrono::duration_cast<std::chrono::milliseconds> (m_batches.front().deadline - clock::now()).count());
+                wait = (wait < 0) ? left : std::min (wait, left);
+            }
+            zmq_pollitem_t items[] =
+            {
+                {(void *) sock.raw_sock(), 0, ZMQ_POLLIN, 0},
+                {nullptr, m_wake_fd, ZMQ_POLLIN, 0}
+            };
+            zmq::poll (items, 2, wait);
+            // reading resets the eventfd's counter (it is nonblocking, so this never waits)
+            uint64_t pokes;
+            if ((items[1].revents & ZMQ_POLLIN) && read (m_wake_fd, &pokes, sizeof (pokes)) < 0)
+            {
+                // already reset; nothing to do
+            }
+            if (items[0].revents & ZMQ_POLLIN)
+            {
+                while (sock.recv_into (rep, ZMQ_DONTWAIT))
+                {
+                    rep.for_each_call ([this] (const uint32_t id, const const_buffer & payload)
+                    {
+                        auto it = m_waiting.find (id);
+                        if (it == m_waiting.end())
+                            return;
+                        it->second.set_value (std::string (static_cast<const char *> (payload.data), payload.size));
+                        m_waiting.erase (it);
+                    });
+                }
+                // answered batches needn't wait for their deadline to leave the queue
+                auto waiting = [this] (const uint32_t id)
+                {
+                    return m_waiting.count (id) > 0;
+                };
+                while (m_batches.size() && std::none_of (m_batches.front().ids.begin(), m_batches.front().ids.end(), waiting))
+                    m_batches.pop_front();
+            }
+            bool due;
+            {
+                std::lock_guard<std::mutex> lock (m_lock);
+                due = m_queue.size() >= m_max_calls || (m_queue.size() && clock::now() >= m_first_at + m_window);
+            }
+            if (due)
+                flush (sock);
+            expire();
+        }
+    }
+
+    BatchServer::BatchServer (const std::string &endpt, handler fn, const size_t threads):
+        m_sock (ZMQ_ROUTER), m_fn (fn), m_threads (threads ? threads : std::max (1u, std::thread::hardware_concurrency())),
+        m_req (true), m_batches (0), m_calls (0), m_malformed (0), m_per (0), m_chunks (0), m_next (0), m_left (0), m_stop (false)
+    {
+        m_sock.bind (endpt);
+        m_sock._bind();
+        for (size_t t = 1; t < m_threads; t++)
+            m_pool.emplace_back (&BatchServer::pool_thread, this);
+    }
+
+    BatchServer::~BatchServer()
+    {
+        {
+            std::lock_guard<std::mutex> lock (m_lock);
+            m_stop = true;
+        }
+        m_work_cv.notify_all();
+        for (std::thread &t : m_pool)
+            t.join();
+    }
+
+    void BatchServer::run_chunk (const size_t c)
+    {
+        const size_t hi = std::min (m_work.size(), (c + 1) * m_per);
+        for (size_t i = c * m_per; i < hi; i++)
+        {
+            try
+            {
+                m_results[i] = m_fn (m_work[i].second);
+            }
+            catch (...)
+            {
+                m_results[i].clear();
+            }
+        }
+    }
+
+    void BatchServer::pool_thread()
+    {
+        std::unique_lock<std::mutex> lock (m_lock);
+        while (true)
+        {
+            m_work_cv.wait (lock, [this]
+            {
+                return m_stop || m_next < m_chunks;
+            });
+            if (m_stop)
+                return;
+            const size_t c = m_next++;
+            lock.unlock();
+            run_chunk (c);
+            lock.lock();
+            if (!--m_left)
+                m_done_cv.notify_one();
+        }
+    }
+
+    void BatchServer::run_batch()
+    {
+        m_results.assign (m_work.size(), std::string());
+        const size_t n = std::min (m_threads, m_work.size());
+        m_per = n ? (m_work.size() + n - 1) / n : 0;
+        std::unique_lock<std::mutex> lock (m_lock);
+        m_chunks = m_left = m_per ? (m_work.size() + m_per - 1) / m_per : 0;
+        m_next = 0;
+        if (m_chunks > 1)
+            m_work_cv.notify_all();
+        // this thread takes chunks too, then waits for the ones the pool took
+        while (m_next < m_chunks)
+        {
+            const size_t c = m_next++;
+            lock.unlock();
+            run_chunk (c);
+            lock.lock();
+            m_left--;
+        }
+        m_done_cv.wait (lock, [this]
+        {
+            return !m_left;
+        });
+    }
+
+    size_t BatchServer::serve_once (const long timeout_ms)
+    {
+        zmq_pollitem_t item = {(void *) m_sock.raw_sock(), 0, ZMQ_POLLIN, 0};
+        if (zmq::poll (&item, 1, timeout_ms) <= 0)
+            return 0;
+        size_t served = 0;
+        while (m_sock.recv_into (m_req, ZMQ_DONTWAIT))
+        {
+            m_work.clear();
+            const bool whole = m_req.for_each_call ([this] (const uint32_t id, const const_buffer & payload)
+            {
+                m_work.push_back (std::make_pair (id, payload));
+            });
+            if (!whole)
+            {
+                m_malformed++;
+                continue;
+            }
+            run_batch();
+
+            m_rep.clear();
+            m_rep.reply_to (m_req);
+            for (size_t i = 0; i < m_work.size(); i++)
+                m_rep.add_call (m_work[i].first, m_results[i]);
+            m_sock.send (m_rep, ZMQ_DONTWAIT);
+            m_calls += m_work.size();
+            m_batches++;
+            served++;
+        }
+        return served;
+    }
+}
@@ -0,0 +1,200 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file batch.h
+ * \author Nathan Eloe
+ * \brief Batched RPC: many small calls travel as one BatchMessage each way
+ *
+ * BatchClient::call() can be used from any thread.  Calls collect until the batch is full or the
+ * first one has waited out the window, and then go to the server as one message; BatchServer runs a
+ * batch's calls in parallel and answers with one message, which the client's I/O thread splits up
+ * among the callers' futures by call id.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "../socket.h"
+#include "../messages/batch.h"
+
+namespace zmqcpp
+{
+    class BatchClient
+    {
+      private:
+        typedef std::chrono::steady_clock clock;
+        struct pending_call
+        {
+            uint32_t id;
+            std::string payload;
+            std::promise<std::string> result;
+        };
+        struct batch
+        {
+            clock::time_point deadline;
+            std::vector<uint32_t> ids;
+        };
+
+        std::string m_endpt;
+        size_t m_max_calls;
+        std::chrono::microseconds m_window;
+        std::chrono::milliseconds m_timeout;
+
+        // calls not yet sent, and when the oldest of them was made
+        std::mutex m_lock;
+        std::vector<pending_call> m_queue;
+        clock::time_point m_first_at;
+        uint32_t m_next_id;
+
+        // owned by the I/O thread: calls sent and waiting for their replies, oldest batch first
+        std::unordered_map<uint32_t, std::promise<std::string>> m_waiting;
+        std::deque<batch> m_batches;
+
+        // an eventfd the I/O thread polls alongside its socket, so callers can wake it
+        int m_wake_fd;
+        std::atomic<bool> m_stop;
+        std::thread m_io;
+
+        void wake();
+        void run();
+        void flush (Socket &sock);
+        void expire();
+
+      public:
+        /*!
+         * \brief Constructor
+         * \pre None
+         * \post the I/O thread is connected to endpt; a batch goes out once it has max_calls calls or its first
+         *       call has waited window; calls not answered within timeout fail
+         * \throws std::runtime_error if the wakeup eventfd can't be created
+         */
+        BatchClient (const std::string &endpt, const size_t max_calls = 64,
+                     const std::chrono::microseconds window = std::chrono::microseconds (200),
+                     const std::chrono::milliseconds timeout = std::chrono::milliseconds (5000));
+        /*!
+         * \brief Destructor
+         * \pre None
+         * \post the I/O thread is stopped; futures of calls still outstanding get a broken_promise error
+         */
+        ~BatchClient();
+        BatchClient (const BatchClient &) = delete;
+        BatchClient &operator= (const BatchClient &) = delete;
+
+        /*!
+         * \brief makes a call
+         * \pre None (safe from any thread)
+         * \post the call is queued for the next batch
+         * \returns a future for the server's reply; it throws std::runtime_error if the call times out, or if
+         *          its batch couldn't be sent (the socket was at its high-water mark)
+         */
+        std::future<std::string> call (const std::string &payload);
+    };
+
+    class BatchServer
+    {
+      public:
+        /*!
+         * \brief answers one call; shouldn't throw (a call whose handler throws is answered with an empty payload)
+         */
+        typedef std::function<std::string (const const_buffer &payload)> handler;
+
+      private:
+        Socket m_sock;
+        handler m_fn;
+        size_t m_threads;
+        BatchMessage m_req, m_rep;
+        uint64_t m_batches, m_calls, m_malformed;
+
+        // the batch being worked on, split into chunks of m_per calls
+        std::vector<std::pair<uint32_t, const_buffer>> m_work;
+        std::vector<std::string> m_results;
+        size_t m_per;
+        // the pool (m_threads - 1 threads; serve_once() works a chunk too) and its hand-off
+        std::vector<std::thread> m_pool;
+        std::mutex m_lock;
+        std::condition_variable m_work_cv, m_done_cv;
+        size_t m_chunks, m_next, m_left;  // chunks in the batch, the next unclaimed one, and those not finished
+        bool m_stop;
+
+        void run_chunk (const size_t c);
+        void pool_thread();
+        void run_batch();
+
+      public:
+        /*!
+         * \brief Constructor
+         * \pre fn is safe to call from several threads at once (if threads > 1)
+         * \post the server will bind endpt; each batch's calls are split among up to threads threads
+         *       (0: one per hardware thread), which are started here and kept for the server's lifetime
+         */
+        BatchServer (const std::string &endpt, handler fn, const size_t threads = 0);
+        /*!
+         * \brief Destructor
+         * \pre None
+         * \post the pool threads are stopped and joined
+         */
+        ~BatchServer();
+        BatchServer (const BatchServer &) = delete;
+        BatchServer &operator= (const BatchServer &) = delete;
+
+        /*!
+         * \brief waits up to timeout_ms for batches and answers every one waiting
+         * \pre None
+         * \post each batch has been answered with one reply holding a result per call, in call order
+         * \returns the number of batches answered
+         */
+        size_t serve_once (const long timeout_ms = -1);
+
+        /*!
+         * \brief counters: batches answered, and the calls in them
+         * \pre None
+         * \post None
+         * \returns the count
+         */
+        uint64_t batches() const
+        {
+            return m_batches;
+        }
+        uint64_t calls() const
+        {
+            return m_calls;
+        }
+        /*!
+         * \brief batches dropped unanswered because their frames weren't [id][payload] pairs
+         * \pre None
+         * \post None
+         * \returns the count; the callers of such a batch get no reply and time out
+         */
+        uint64_t malformed() const
+        {
+            return m_malformed;
+        }
+    };
+}
@@ -0,0 +1,156 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file coalesce.cpp
+ * \author Nathan Eloe
+ * \brief Implementation of the small-message coalescer
+ */
+
+#include "coalesce.h"
+#include <algorithm>
+
+namespace zmqcpp
+{
+    const std::string COALESCED_MARKER ("\0ZCB", 4);
+
+    // bytes needed for len as a varint
+    static size_t varint_size (size_t len)
+    {
+        size_t n = 1;
+        while (len >>= 7)
+            n++;
+        return n;
+    }
+
+    Coalescer::Coalescer (Socket &sock, const size_t max_bytes, const std::chrono::microseconds window, const size_t cutoff):
+        m_sock (sock), m_max_bytes (max_bytes), m_cutoff (cutoff), m_window (window), m_count (0), m_first_at (0), m_stats ()
+    {
+        m_buf.reserve (max_bytes);
+        m_stats.max_bytes = max_bytes;
+        m_stats.window_us = window.count();
+    }
+
+    bool Coalescer::send_plain (const void *data, const size_t size, const int opts)
+    {
+        const const_buffer buf = {data, size};
+        if (!m_sock.sendv (&buf, 1, opts))
+        {
+            m_stats.failed++;
+            return false;
+        }
+        m_stats.plain++;
+        return true;
+    }
+
+    bool Coalescer::send (const void *data, const size_t size, const int opts)
+    {
+        if (size >= m_cutoff)
+        {
+            // keep order: whatever is waiting goes first
+            if (!flush (opts) || !send_plain (data, size, opts))
+                return false;
+            m_stats.messages++;
+            return true;
+        }
+        const size_t need = varint_size (size) + size;
+        if (m_count && m_buf.size() + need > m_max_bytes && !send_batch (opts, true))
+            return false;
+        if (!m_count)
+        {
+            m_started = clock::now();
+            m_deadline = m_started + m_window;
+        }
+        for (size_t len = size; ; len >>= 7)
+        {
+            if (len < 0x80)
+            {
+                m_buf.push_back (static_cast<char> (len));
+                break;
+            }
+            m_buf.push_back (static_cast<char> ((len & 0x7f) | 0x80));
+        }
+        if (!m_count)
+            m_first_at = m_buf.size();
+        m_buf.append (static_cast<const char *> (data), size);
+        m_count++;
+        m_stats.messages++;
+        // a refused batch is kept, and so is this message, so the send still counts as taken
+        if (m_buf.size() >= m_max_bytes)
+            send_batch (opts, true);
+        else if (clock::now() >= m_deadline)
+            send_batch (opts, false);
+        return true;
+    }
+
+    bool Coalescer::tick (const int opts)
+    {
+        if (!m_count || clock::now() < m_deadline)
+            return true;
+        return flush (opts);
+    }
+
+    bool Coalescer::flush (const int opts)
+    {
+        return send_batch (opts, false);
+    }
+
+    bool Coalescer::send_batch (const int opts, const bool full)
+    {
+        if (!m_count)
+            return true;
+        if (m_count == 1)
+        {
+            if (!send_plain (m_buf.data() + m_first_at, m_buf.size() - m_first_at, opts))
+                return false;
+        }
+        else
+        {
+            const const_buffer bufs[] = {buffer (COALESCED_MARKER), buffer (m_buf)};
+            if (!m_sock.sendv (bufs, 2, opts))
+            {
+                m_stats.failed++;
+                return false;
+            }
+            m_stats.packed++;
+        }
+        m_stats.batches++;
+        m_stats.full += full;
+        m_stats.waited_us += std::chrono::duration_cast<std::chrono::microseconds> (clock::now() - m_started).count();
+        m_buf.clear();
+        m_count = 0;
+        return true;
+    }
+
+    long Coalescer::due_in_ms() const
+    {
+        if (!m_count)
+            return -1;
+        const long us = std::chrono::duration_cast<std::chrono::microseconds> (m_deadline - clock::now()).count();
+        return std::max (0l, (us + 999) / 1000);
+    }
+
+    void Coalescer::set_limits (const size_t max_bytes, const std::chrono::microseconds window)
+    {
+        m_max_bytes = max_bytes;
+        m_window = window;
+        m_stats.max_bytes = max_bytes;
+        m_stats.window_us = window.count();
+        if (m_buf.capacity() < max_bytes)
+            m_buf.reserve (max_bytes);
+    }
+}
@@ -0,0 +1,235 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file coalesce.h
+ * \author Nathan Eloe
+ * \brief Packs many small messages into one frame on the way out, and unpacks them on the way in
+ *
+ * A packed message is two frames: COALESCED_MARKER, then the messages back to back, each preceded by its
+ * length as a varint (7 bits a byte, low bits first).  Anything at or over the coalescer's size cutoff,
+ * and a batch holding just one message, goes out as a plain one-frame message, so large traffic looks
+ * the same on the wire as it always did.  recv_coalesced() hands back every message either way, as
+ * views straight into the received frame.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include "../socket.h"
+
+namespace zmqcpp
+{
+    /*!
+     * \brief The first frame of a packed message
+     */
+    extern const std::string COALESCED_MARKER;
+
+    /*!
+     * \brief Counters kept by a Coalescer
+     */
+    struct coalesce_stats
+    {
+        uint64_t messages;  // messages handed to send()
+        uint64_t packed;    // packed frames sent
+        uint64_t plain;     // messages sent on their own (too big, or alone when their batch went out)
+        uint64_t failed;    // sends libzmq turned away
+        uint64_t batches;   // batches sent (packed, or alone)
+        uint64_t full;      // of those, the ones sent because they reached the byte budget
+        uint64_t waited_us; // total time the first message of each batch waited
+        // the current limits (see Coalescer::set_limits())
+        size_t max_bytes;
+        uint64_t window_us;
+    };
+
+    class Coalescer
+    {
+      private:
+        typedef std::chrono::steady_clock clock;
+        Socket &m_sock;
+        size_t m_max_bytes, m_cutoff;
+        std::chrono::microseconds m_window;
+        // the packed frame being built; its capacity is kept from batch to batch
+        std::string m_buf;
+        size_t m_count;
+        // where the only message starts in m_buf (after its length), for sending a batch of one plain
+        size_t m_first_at;
+        clock::time_point m_started, m_deadline;
+        coalesce_stats m_stats;
+
+        bool send_plain (const void *data, const size_t size, const int opts);
+        bool send_batch (const int opts, const bool full);
+
+      public:
+        /*!
+         * \brief Constructor
+         * \pre sock isn't a ROUTER (packing ignores routing frames)
+         * \post messages under cutoff bytes are packed; a batch goes out once it would pass max_bytes or
+         *       its first message has waited window
+         */
+        Coalescer (Socket &sock, const size_t max_bytes = 8192,
+                   const std::chrono::microseconds window = std::chrono::microseconds (100), const size_t cutoff = 512);
+
+        ///@{
+        /*!
+         * \brief sends one message, packing it with others if it is small
+         * \pre None
+         * \post a small message is in the current batch (which may have gone out first to make room, or
+         *       after, if its time was up); a big one is sent right away, after the current batch
+         * \returns false if libzmq turned a send away; the message wasn't taken
+         */
+        bool send (const void *data, const size_t size, const int opts = 0);
+        bool send (const std::string &data, const int opts = 0)
+        {
+            return send (data.data(), data.size(), opts);
+        }
+        ///@}
+
+        /*!
+         * \brief sends the current batch if its window has passed; call this from the sending loop
+         * \pre None
+         * \post None
+         * \returns false if the batch was due but libzmq turned it away (it stays queued)
+         */
+        bool tick (const int opts = 0);
+        /*!
+         * \brief sends the current batch now
+         * \pre None
+         * \post the batch is empty, unless libzmq turned it away
+         * \returns false if libzmq turned it away
+         */
+        bool flush (const int opts = 0);
+        /*!
+         * \brief how long until the current batch is due
+         * \pre None
+         * \post None
+         * \returns milliseconds, rounded up, to use as a poll timeout (-1 with nothing waiting)
+         */
+        long due_in_ms() const;
+
+        /*!
+         * \brief changes the limits (e.g. from an adaptive controller)
+         * \pre max_bytes > 0
+         * \post the byte budget applies from the next message on, the window from the next batch; stats() shows both
+         */
+        void set_limits (const size_t max_bytes, const std::chrono::microseconds window);
+
+        /*!
+         * \brief the current batch, and the limits
+         * \pre None
+         * \post None
+         * \returns the value
+         */
+        size_t pending() const
+        {
+            return m_count;
+        }
+        size_t pending_bytes() const
+        {
+            return m_buf.size();
+        }
+        size_t max_bytes() const
+        {
+            return m_max_bytes;
+        }
+        std::chrono::microseconds window() const
+        {
+            return m_window;
+        }
+        /*!
+         * \brief this coalescer's counters
+         * \pre None
+         * \post None
+         * \returns the counters
+         */
+        const coalesce_stats &stats() const
+        {
+            return m_stats;
+        }
+        /*!
+         * \brief the socket underneath
+         * \pre None
+         * \post None
+         * \returns the socket
+         */
+        Socket &socket()
+        {
+            return m_sock;
+        }
+    };
+
+    /*!
+     * \brief walks the messages packed in a frame, without copying
+     * \pre fn is callable as fn (const const_buffer &msg)
+     * \post fn has seen every message, up to the first malformed length
+     * \returns false if a length runs past the end of the frame
+     */
+    template <class F>
+    bool unpack_coalesced (const const_buffer &frame, F fn)
+    {
+        const unsigned char *p = static_cast<const unsigned char *> (frame.data), *end = p + frame.size;
+        while (p < end)
+        {
+            uint64_t len = 0;
+            unsigned shift = 0;
+            while (true)
+            {
+                if (p == end || shift > 63)
+                    return false;
+                len |= static_cast<uint64_t> (*p & 0x7f) << shift;
+                shift += 7;
+                if (! (*p++ & 0x80))
+                    break;
+            }
+            if (len > static_cast<uint64_t> (end - p))
+                return false;
+            fn (const_buffer {p, static_cast<size_t> (len)});
+            p += len;
+        }
+        return true;
+    }
+
+    /*!
+     * \brief receives one message and hands over what is in it: every packed message, or the plain one
+     * \pre fn is callable as fn (const const_buffer &msg); the views are only good during the call
+     * \post the whole message has been read from sock
+     * \returns false if the recv failed or a packed frame was malformed
+     */
+    template <class F>
+    bool recv_coalesced (Socket &sock, F fn, const int opts = 0)
+    {
+        bool packed = false, ok = true;
+        size_t seen = 0;
+        const bool win = sock.recv_frames ([&] (const const_buffer & f, bool more) -> frame_act
+        {
+            if (!seen++ && more && f.size == COALESCED_MARKER.size() && !memcmp (f.data, COALESCED_MARKER.data(), f.size))
+            {
+                packed = true;
+                return FRAME_NEXT;
+            }
+            if (packed)
+                ok = unpack_coalesced (f, fn);
+            else
+                fn (f);
+            return FRAME_SKIP;
+        }, opts);
+        return win && ok;
+    }
+}
@@ -0,0 +1,78 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file coalesce_control.cpp
+ * \author Nathan Eloe
+ * \brief Implementation of the adaptive coalescing controller
+ */
+
+#include "coalesce_control.h"
+#include <algorithm>
+
+namespace zmqcpp
+{
+    CoalesceController::CoalesceController (Coalescer &out, const coalesce_limits &lim, const std::chrono::microseconds interval):
+        m_out (out), m_lim (lim), m_interval (interval),
+        m_bytes_step (std::max<size_t> (1, (lim.max_bytes - lim.min_bytes) / 16)),
+        m_window_step (std::max<std::chrono::microseconds::rep> (1, (lim.max_window - lim.min_window).count() / 16)),
+        m_next (clock::now()), m_last_out (out.stats()), m_last_blocked (out.socket().stats().would_block),
+        m_wait_us (0), m_stats ()
+    {
+        m_out.set_limits (lim.min_bytes, lim.min_window);
+    }
+
+    bool CoalesceController::update()
+    {
+        const clock::time_point now = clock::now();
+        if (now < m_next)
+            return false;
+        m_next = now + m_interval;
+        m_stats.samples++;
+
+        Socket &sock = m_out.socket();
+        const coalesce_stats &out = m_out.stats();
+        const uint64_t batches = out.batches - m_last_out.batches, full = out.full - m_last_out.full;
+        const uint64_t blocked = sock.stats().would_block - m_last_blocked;
+        if (batches)
+            m_wait_us = 0.75 * m_wait_us + 0.25 * (out.waited_us - m_last_out.waited_us) / batches;
+        m_last_out = out;
+        m_last_blocked = sock.stats().would_block;
+
+        const bool pressure = full || blocked || sock.outbox_depth() || !sock.writable();
+        size_t bytes = m_out.max_bytes();
+        std::chrono::microseconds window = m_out.window();
+        if (pressure && m_wait_us <= m_lim.target_wait.count())
+        {
+            bytes = std::min (m_lim.max_bytes, bytes + m_bytes_step);
+            window = std::min (m_lim.max_window, window + m_window_step);
+        }
+        else
+        {
+            bytes = std::max (m_lim.min_bytes, bytes / 2);
+            window = std::max (m_lim.min_window, window / 2);
+        }
+        if (bytes == m_out.max_bytes() && window == m_out.window())
+            return false;
+        if (bytes > m_out.max_bytes() || window > m_out.window())
+            m_stats.increases++;
+        else
+            m_stats.decreases++;
+        m_out.set_limits (bytes, window);
+        return true;
+    }
+}
@@ -0,0 +1,115 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file coalesce_control.h
+ * \author Nathan Eloe
+ * \brief Tunes a Coalescer's byte budget and window to the load it sees
+ *
+ * The controller samples the socket and the coalescer once per interval.  The socket is under pressure
+ * when it has messages in its outbox, has turned sends away since the last sample, or isn't writable
+ * (ZMQ_EVENTS), or when batches have been filling their byte budget.  Under pressure, while batches
+ * aren't waiting longer than the target, the budget and window grow by a fixed step.  Otherwise they
+ * halve.  So an idle socket sends each message almost at once, and a busy one packs as much as the
+ * limits allow.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include "coalesce.h"
+
+namespace zmqcpp
+{
+    /*!
+     * \brief The range a CoalesceController keeps a Coalescer in
+     */
+    struct coalesce_limits
+    {
+        size_t min_bytes, max_bytes;
+        std::chrono::microseconds min_window, max_window;
+        // the average time a batch's first message may wait before the controller backs off
+        std::chrono::microseconds target_wait;
+    };
+
+    /*!
+     * \brief Counters kept by a CoalesceController
+     */
+    struct control_stats
+    {
+        uint64_t samples;    // intervals looked at
+        uint64_t increases;  // additive steps up
+        uint64_t decreases;  // halvings
+    };
+
+    class CoalesceController
+    {
+      private:
+        typedef std::chrono::steady_clock clock;
+        Coalescer &m_out;
+        coalesce_limits m_lim;
+        std::chrono::microseconds m_interval;
+        // additive steps: a sixteenth of each range
+        size_t m_bytes_step;
+        std::chrono::microseconds m_window_step;
+        clock::time_point m_next;
+        // the counters as of the last sample, to take differences from
+        coalesce_stats m_last_out;
+        uint64_t m_last_blocked;
+        double m_wait_us;
+        control_stats m_stats;
+
+      public:
+        /*!
+         * \brief Constructor
+         * \pre 0 < lim.min_bytes <= lim.max_bytes, and lim.min_window <= lim.max_window
+         * \post out starts at the low end of the limits; update() samples at most once per interval
+         */
+        CoalesceController (Coalescer &out, const coalesce_limits &lim,
+                            const std::chrono::microseconds interval = std::chrono::microseconds (1000));
+
+        /*!
+         * \brief samples the load and adjusts the coalescer, if an interval has passed; call this from the sending loop
+         * \pre None
+         * \post the coalescer's limits have moved one step (see the file comment); its stats() show them
+         * \returns true if the limits changed
+         */
+        bool update();
+
+        /*!
+         * \brief the recent average time a batch's first message waited
+         * \pre None
+         * \post None
+         * \returns microseconds (a moving average over sampled intervals)
+         */
+        double avg_wait_us() const
+        {
+            return m_wait_us;
+        }
+        /*!
+         * \brief this controller's counters
+         * \pre None
+         * \post None
+         * \returns the counters
+         */
+        const control_stats &stats() const
+        {
+            return m_stats;
+        }
+    };
+}
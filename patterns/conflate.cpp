@@ -0,0 +1,72 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file conflate.cpp
+ * \author Nathan Eloe
+ * \brief Implementation of the conflating subscriber
+ */
+
+#include "conflate.h"
+
+namespace zmqcpp
+{
+    ConflatingSubscriber::ConflatingSubscriber (const std::string &endpt): m_sock (ZMQ_SUB), m_received (0), m_conflated (0)
+    {
+        m_sock.connect (endpt);
+    }
+
+    void ConflatingSubscriber::subscribe (const std::string &prefix)
+    {
+        m_sock._conn();
+        m_sock.raw_sock().setsockopt (ZMQ_SUBSCRIBE, prefix.data(), prefix.size());
+    }
+
+    size_t ConflatingSubscriber::poll (const long timeout_ms)
+    {
+        m_sock._conn();
+        zmq_pollitem_t item = {(void *) m_sock.raw_sock(), 0, ZMQ_POLLIN, 0};
+        if (zmq::poll (&item, 1, timeout_ms) <= 0)
+            return 0;
+        size_t taken = 0;
+        while (m_sock.recv_into (m_in, ZMQ_DONTWAIT))
+        {
+            const const_buffer topic = m_in.front_view();
+            m_key.assign (static_cast<const char *> (topic.data), topic.size);
+            auto it = m_index.find (m_key);
+            if (it == m_index.end())
+            {
+                it = m_index.emplace (m_key, m_slots.size()).first;
+                m_slots.push_back (slot());
+                m_slots.back().dirty = false;
+            }
+            slot &s = m_slots[it->second];
+            // the slot's previous frames come back to m_in, to be refilled by the next recv
+            s.msg.swap (m_in);
+            if (s.dirty)
+                m_conflated++;
+            else
+            {
+                s.dirty = true;
+                m_dirty.push_back (it->second);
+            }
+            taken++;
+        }
+        m_received += taken;
+        return taken;
+    }
+}
@@ -0,0 +1,136 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file conflate.h
+ * \author Nathan Eloe
+ * \brief A subscriber that keeps only the newest message per topic
+ *
+ * ZMQ_CONFLATE keeps one message per socket and can't handle multipart messages.  ConflatingSubscriber
+ * drains everything queued on its SUB socket into one slot per topic (the first frame), so a consumer
+ * that falls behind reads the latest value of each topic once instead of working through the backlog.
+ * Slots sit in one vector and a received message is swapped into its slot, handing the slot's old
+ * frames back for the next recv_into(), so a steady stream of updates doesn't allocate.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../socket.h"
+#include "../messages/message.h"
+
+namespace zmqcpp
+{
+    class ConflatingSubscriber
+    {
+      private:
+        struct slot
+        {
+            Message msg;
+            bool dirty;
+        };
+        Socket m_sock;
+        std::vector<slot> m_slots;
+        std::unordered_map<std::string, size_t> m_index;
+        // slots updated since the last drain, in the order they were first updated
+        std::vector<size_t> m_dirty;
+        Message m_in;
+        std::string m_key;
+        uint64_t m_received, m_conflated;
+
+      public:
+        /*!
+         * \brief Constructor
+         * \pre None
+         * \post the subscriber will connect to endpt; it receives nothing until subscribe() is called
+         */
+        ConflatingSubscriber (const std::string &endpt);
+
+        /*!
+         * \brief subscribes to messages starting with prefix
+         * \pre None
+         * \post the socket is subscribed to prefix
+         */
+        void subscribe (const std::string &prefix);
+
+        /*!
+         * \brief waits up to timeout_ms for messages and takes in everything queued
+         * \pre None
+         * \post every queued message is in its topic's slot, replacing any value not yet drained
+         * \returns the number of messages taken in
+         */
+        size_t poll (const long timeout_ms = 0);
+
+        /*!
+         * \brief hands over the latest value of every topic updated since the last drain
+         * \pre fn is callable as void fn (Message &msg)
+         * \post fn has seen each updated topic's newest message once, in order of first update;
+         *       the messages stay in their slots, so don't keep references to them past the next poll()
+         * \returns the number of topics handed over
+         */
+        template <class F>
+        size_t drain (F fn)
+        {
+            for (const size_t i : m_dirty)
+            {
+                m_slots[i].dirty = false;
+                fn (m_slots[i].msg);
+            }
+            const size_t n = m_dirty.size();
+            m_dirty.clear();
+            return n;
+        }
+
+        /*!
+         * \brief the number of topics waiting to be drained
+         * \pre None
+         * \post None
+         * \returns the count
+         */
+        size_t pending() const
+        {
+            return m_dirty.size();
+        }
+        /*!
+         * \brief counters: messages taken in, and those replaced before anyone drained them
+         * \pre None
+         * \post None
+         * \returns the count
+         */
+        uint64_t received() const
+        {
+            return m_received;
+        }
+        uint64_t conflated() const
+        {
+            return m_conflated;
+        }
+        /*!
+         * \brief the socket underneath
+         * \pre None
+         * \post None
+         * \returns the Socket
+         */
+        Socket &socket()
+        {
+            return m_sock;
+        }
+    };
+}
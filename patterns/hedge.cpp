@@ -0,0 +1,134 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file hedge.cpp
+ * \author Nathan Eloe
+ * \brief Implementation of the hedging request client
+ */
+
+#include "hedge.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace zmqcpp
+{
+    const uint64_t HedgedClient::WARMUP;
+    const uint64_t HedgedClient::WINDOW;
+
+    HedgedClient::HedgedClient (const std::vector<std::string> &backends, const double quantile, const uint64_t initial_us):
+        m_quantile (quantile), m_initial_us (initial_us), m_next_id (0), m_next_backend (0), m_stats ()
+    {
+        for (const std::string &b : backends)
+        {
+            m_backends.emplace_back (new Socket (ZMQ_DEALER));
+            m_backends.back()->connect (b);
+        }
+    }
+
+    uint64_t HedgedClient::hedge_delay_us() const
+    {
+        return m_hist.count() < WARMUP ? m_initial_us : m_hist.percentile (m_quantile);
+    }
+
+    bool HedgedClient::send_to (const size_t b, const uint64_t id)
+    {
+        // [id][""][body...]: the id and delimiter go on the front of the body built by request()
+        m_out.prepend ("", 0);
+        m_out.prepend (reinterpret_cast<const char *> (&id), sizeof (id));
+        const bool win = m_backends[b]->send (m_out, ZMQ_DONTWAIT);
+        m_out.pop_front();
+        m_out.pop_front();
+        return win;
+    }
+
+    bool HedgedClient::request (Message &reply, const long timeout_ms)
+    {
+        typedef std::chrono::steady_clock clock;
+        const uint64_t id = ++m_next_id;
+        const size_t n = m_backends.size();
+        const size_t first = m_next_backend++ % n;
+        m_stats.requests++;
+
+        const clock::time_point start = clock::now(), deadline = start + std::chrono::milliseconds (timeout_ms);
+        clock::time_point hedge_at = start + std::chrono::microseconds (hedge_delay_us());
+        // a backend nobody is connected to turns the request away at once: hedge straight away
+        const bool sent = send_to (first, id);
+        if (!sent)
+            hedge_at = start;
+        bool hedged = n < 2;
+        clock::time_point hedge_sent = start;
+        size_t second = first;
+
+        std::vector<zmq_pollitem_t> items (n);
+        for (size_t b = 0; b < n; b++)
+        {
+            m_backends[b]->_conn();
+            items[b] = {(void *) m_backends[b]->raw_sock(), 0, ZMQ_POLLIN, 0};
+        }
+        while (true)
+        {
+            clock::time_point now = clock::now();
+            if (!hedged && now >= hedge_at)
+            {
+                hedged = true;
+                second = (first + 1) % n;
+                hedge_sent = now;
+                if (send_to (second, id))
+                    m_stats.hedged++;
+            }
+            if (now >= deadline)
+            {
+                m_stats.timeouts++;
+                return false;
+            }
+            const clock::time_point until = hedged ? deadline : std::min (deadline, hedge_at);
+            // zmq::poll counts in milliseconds; round up so a short hedge delay doesn't spin
+            const long wait = (std::chrono::duration_cast<std::chrono::microseconds> (until - now).count() + 999) / 1000;
+            if (zmq::poll (items.data(), n, wait) <= 0)
+                continue;
+            for (size_t b = 0; b < n; b++)
+            {
+                if (! (items[b].revents & ZMQ_POLLIN))
+                    continue;
+                while (m_backends[b]->recv_into (m_in, ZMQ_DONTWAIT))
+                {
+                    const const_buffer got = m_in.front_view();
+                    if (got.size != sizeof (id) || memcmp (got.data, &id, sizeof (id)))
+                    {
+                        m_stats.stale++;
+                        continue;
+                    }
+                    now = clock::now();
+                    // time the reply from when the backend that answered was sent the request
+                    const clock::time_point sent_at = (hedged && b == second && b != first) ? hedge_sent : start;
+                    m_hist.record (std::chrono::duration_cast<std::chrono::microseconds> (now - sent_at).count());
+                    if (m_hist.count() >= WINDOW)
+                        m_hist.decay();
+                    if (b != first)
+                        m_stats.hedge_wins++;
+                    // drop the id and delimiter; the body's frames go to reply as they are
+                    m_in.pop_front();
+                    m_in.pop_front();
+                    reply.swap (m_in);
+                    return true;
+                }
+            }
+        }
+    }
+}
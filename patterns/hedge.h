@@ -0,0 +1,125 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file hedge.h
+ * \author Nathan Eloe
+ * \brief A request client that sends a second copy of a slow request to another backend
+ *
+ * Each request goes to one backend as [request id][""][body...] over that backend's DEALER socket.
+ * If no reply has come back after the hedge delay (by default the running 95th percentile of reply
+ * times), the same request goes to the next backend too.  The first reply with the right id wins;
+ * anything else that turns up later is recognized by its id and thrown away.  REP servers echo the
+ * id frame back on their own, since it sits ahead of the empty delimiter.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "histogram.h"
+#include "../socket.h"
+#include "../messages/message.h"
+
+namespace zmqcpp
+{
+    /*!
+     * \brief Counters kept by HedgedClient
+     */
+    struct hedge_stats
+    {
+        uint64_t requests;
+        uint64_t hedged;      // requests that went to a second backend
+        uint64_t hedge_wins;  // hedged requests the second backend answered first
+        uint64_t stale;       // replies discarded because their request had already been answered
+        uint64_t timeouts;
+    };
+
+    class HedgedClient
+    {
+      private:
+        std::vector<std::unique_ptr<Socket>> m_backends;
+        LatencyHistogram m_hist;
+        double m_quantile;
+        uint64_t m_initial_us, m_next_id;
+        size_t m_next_backend;
+        Message m_out, m_in;
+        hedge_stats m_stats;
+
+        // samples recorded before the histogram is trusted, and the count at which old ones are decayed
+        static const uint64_t WARMUP = 20, WINDOW = 2000;
+
+        bool send_to (const size_t b, const uint64_t id);
+
+      public:
+        /*!
+         * \brief Constructor
+         * \pre backends isn't empty; each one serves the same requests
+         * \post the client will connect a DEALER to every backend; until enough replies are timed, the
+         *       hedge delay is initial_us
+         */
+        HedgedClient (const std::vector<std::string> &backends, const double quantile = 0.95,
+                      const uint64_t initial_us = 10000);
+
+        /*!
+         * \brief sends req and waits up to timeout_ms for a reply, hedging to a second backend after the hedge delay
+         * \pre None
+         * \post on success reply holds the winning reply's body and its reply time is in the histogram
+         * \returns false if no reply came back in time
+         */
+        template <class T>
+        bool request (const BaseMessage<T> &req, Message &reply, const long timeout_ms = 1000)
+        {
+            m_out.clear();
+            m_out.share_frames (req);
+            return request (reply, timeout_ms);
+        }
+
+        /*!
+         * \brief the current hedge delay
+         * \pre None
+         * \post None
+         * \returns how long a request waits before it is hedged, in microseconds
+         */
+        uint64_t hedge_delay_us() const;
+        /*!
+         * \brief the reply times seen so far
+         * \pre None
+         * \post None
+         * \returns the histogram (microseconds)
+         */
+        const LatencyHistogram &latencies() const
+        {
+            return m_hist;
+        }
+        /*!
+         * \brief the counters
+         * \pre None
+         * \post None
+         * \returns the stats
+         */
+        const hedge_stats &stats() const
+        {
+            return m_stats;
+        }
+
+      private:
+        bool request (Message &reply, const long timeout_ms);
+    };
+}
@@ -0,0 +1,119 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file histogram.h
+ * \author Nathan Eloe
+ * \brief A fixed-size log-linear histogram for latencies and other non-negative counts
+ *
+ * Values below 8 get a bucket each; above that every power of two is split into 8 equal buckets,
+ * so any value is placed within 12.5% of itself in one of 496 counters, with no allocation.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+
+namespace zmqcpp
+{
+    class LatencyHistogram
+    {
+      public:
+        static const int SUB_BITS = 3;
+        static const size_t SUB = 1 << SUB_BITS;
+        static const size_t BUCKETS = SUB + (64 - SUB_BITS) * SUB;
+
+      private:
+        std::array<uint64_t, BUCKETS> m_counts;
+        uint64_t m_total;
+
+        static size_t bucket (const uint64_t v)
+        {
+            if (v < SUB)
+                return v;
+            const int e = 63 - __builtin_clzll (v);
+            return SUB + (e - SUB_BITS) * SUB + ((v >> (e - SUB_BITS)) & (SUB - 1));
+        }
+        // the largest value bucket b holds
+        static uint64_t upper (const size_t b)
+        {
+            if (b < SUB)
+                return b;
+            const int shift = (b - SUB) / SUB;
+            const uint64_t lo = (SUB + (b - SUB) % SUB) << shift;
+            return lo + ((1ull << shift) - 1);
+        }
+
+      public:
+        /*!
+         * \brief Constructor
+         * \pre None
+         * \post the histogram is empty
+         */
+        LatencyHistogram(): m_counts(), m_total (0) {}
+
+        /*!
+         * \brief counts one value
+         * \pre None
+         * \post v's bucket is one higher
+         */
+        void record (const uint64_t v)
+        {
+            m_counts[bucket (v)]++;
+            m_total++;
+        }
+        /*!
+         * \brief the value below which a fraction q of the recorded values fall
+         * \pre 0 <= q <= 1
+         * \post None
+         * \returns the upper edge of the bucket holding the qth quantile (0 if nothing is recorded)
+         */
+        uint64_t percentile (const double q) const
+        {
+            const uint64_t want = std::max<uint64_t> (1, static_cast<uint64_t> (std::ceil (q * m_total)));
+            uint64_t seen = 0;
+            for (size_t b = 0; b < BUCKETS; b++)
+                if ((seen += m_counts[b]) >= want)
+                    return upper (b);
+            return 0;
+        }
+        /*!
+         * \brief halves every count, so older values weigh less than newer ones
+         * \pre None
+         * \post each bucket (and the total) is half what it was, rounded down
+         */
+        void decay()
+        {
+            m_total = 0;
+            for (uint64_t &c : m_counts)
+                m_total += (c >>= 1);
+        }
+        /*!
+         * \brief the number of values recorded (since the last decay, half of those before it, and so on)
+         * \pre None
+         * \post None
+         * \returns the count
+         */
+        uint64_t count() const
+        {
+            return m_total;
+        }
+    };
+}
@@ -0,0 +1,184 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file last_value_cache.cpp
+ * \author Nathan Eloe
+ * \brief Implementation of the last value cache and its snapshot client
+ */
+
+#include "last_value_cache.h"
+#include <cstring>
+#include "../messages/envelope.h"
+
+namespace zmqcpp
+{
+    const std::string LastValueCache::SNAPSHOT_END ("\0END", 4);
+
+    LastValueCache::LastValueCache (const std::string &frontend, const std::string &backend, const std::string &snapshot,
+                                    const size_t max_bytes):
+        m_front (ZMQ_XSUB), m_back (ZMQ_XPUB), m_snap (ZMQ_ROUTER), m_has_snap (!snapshot.empty()), m_bytes (0),
+        m_max_bytes (max_bytes), m_updates (0), m_replayed (0), m_evicted (0)
+    {
+        m_front.bind (frontend);
+        // every subscriber's subscribe reaches us, not just the first one per topic
+        m_back.setsockopt (ZMQ_XPUB_VERBOSE, 1);
+        m_back.bind (backend);
+        m_back._bind();
+        if (m_has_snap)
+        {
+            m_snap.bind (snapshot);
+            m_snap._bind();
+        }
+        // XSUB subscribes by sending [1][prefix]: take everything
+        const char all = 1;
+        const const_buffer sub = {&all, 1};
+        m_front.sendv (&sub, 1);
+    }
+
+    bool LastValueCache::serve_once (const long timeout_ms)
+    {
+        zmq_pollitem_t items[] =
+        {
+            {(void *) m_front.raw_sock(), 0, ZMQ_POLLIN, 0},
+            {(void *) m_back.raw_sock(), 0, ZMQ_POLLIN, 0},
+            {m_has_snap ? (void *) m_snap.raw_sock() : nullptr, 0, ZMQ_POLLIN, 0}
+        };
+        if (zmq::poll (items, m_has_snap ? 3 : 2, timeout_ms) <= 0)
+            return false;
+        if (items[0].revents & ZMQ_POLLIN)
+            update();
+        if (items[1].revents & ZMQ_POLLIN)
+            subscribed();
+        if (m_has_snap && (items[2].revents & ZMQ_POLLIN))
+            snapshot();
+        return true;
+    }
+
+    void LastValueCache::update()
+    {
+        while (m_front.recv_into (m_in, ZMQ_DONTWAIT))
+        {
+            const const_buffer topic = m_in.front_view();
+            m_key.assign (static_cast<const char *> (topic.data), topic.size);
+            auto it = m_cache.find (m_key);
+            if (it == m_cache.end())
+            {
+                it = m_cache.emplace (m_key, entry()).first;
+                it->second.bytes = 0;
+                m_lru.push_front (&it->first);
+                it->second.lru = m_lru.begin();
+                m_index.insert (m_key, &it->second);
+            }
+            else
+                m_lru.splice (m_lru.begin(), m_lru, it->second.lru);
+            entry &e = it->second;
+            m_bytes -= e.bytes;
+            // the frames move over as they are; m_in starts the next recv empty
+            e.msg.clear();
+            e.msg += m_in;
+            e.bytes = e.msg.bytes() + m_key.size();
+            m_bytes += e.bytes;
+            m_updates++;
+            m_back.send (e.msg);
+            evict();
+        }
+    }
+
+    void LastValueCache::evict()
+    {
+        // the newest topic always stays, however big it is
+        while (m_bytes > m_max_bytes && m_lru.size() > 1)
+        {
+            const std::string &key = *m_lru.back();
+            m_lru.pop_back();
+            m_index.erase (key);
+            auto it = m_cache.find (key);
+            m_bytes -= it->second.bytes;
+            m_cache.erase (it);
+            m_evicted++;
+        }
+    }
+
+    void LastValueCache::subscribed()
+    {
+        bool sub = false;
+        auto take = [this, &sub] (const const_buffer & f, bool) -> frame_act
+        {
+            const char *data = static_cast<const char *> (f.data);
+            sub = f.size && data[0] == 1;
+            if (sub)
+                m_key.assign (data + 1, f.size - 1);
+            return FRAME_SKIP;
+        };
+        while (m_back.recv_frames (take, ZMQ_DONTWAIT))
+        {
+            if (!sub)
+                continue;
+            m_index.visit_prefix (m_key, [this] (const std::string &, entry * const & e)
+            {
+                m_back.send (e->msg);
+                m_replayed++;
+            });
+        }
+    }
+
+    void LastValueCache::snapshot()
+    {
+        EnvelopeMessage req (1), reply;
+        while (m_snap.recv_into (req, ZMQ_DONTWAIT))
+        {
+            const const_buffer prefix = req.front_view();
+            m_key.assign (static_cast<const char *> (prefix.data), prefix.size);
+            reply.copy_envelope (req);
+            m_index.visit_prefix (m_key, [this, &reply] (const std::string &, entry * const & e)
+            {
+                reply.clear();
+                reply.share_frames (e->msg);
+                m_snap.send (reply);
+            });
+            reply.clear();
+            reply.add_frame (SNAPSHOT_END);
+            m_snap.send (reply);
+        }
+    }
+
+    bool fetch_snapshot (const std::string &endpt, const std::string &prefix, std::function<void (Message &)> fn,
+                         const long timeout_ms)
+    {
+        Socket sock (ZMQ_DEALER);
+        sock.connect (endpt);
+        Message msg;
+        msg.add_frame (prefix);
+        sock.send (msg);
+        while (true)
+        {
+            zmq_pollitem_t item = {(void *) sock.raw_sock(), 0, ZMQ_POLLIN, 0};
+            if (zmq::poll (&item, 1, timeout_ms) <= 0)
+            {
+                sock.disconnect();
+                return false;
+            }
+            sock.recv_into (msg);
+            const const_buffer first = msg.front_view();
+            const std::string &end = LastValueCache::SNAPSHOT_END;
+            if (first.size == end.size() && !memcmp (first.data, end.data(), first.size))
+                return true;
+            fn (msg);
+        }
+    }
+}
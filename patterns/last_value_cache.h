@@ -0,0 +1,140 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file last_value_cache.h
+ * \author Nathan Eloe
+ * \brief A pub/sub proxy that remembers the last message on every topic for subscribers that join late
+ *
+ * Publishers connect to the XSUB frontend and subscribers to the XPUB backend, as with any proxy.  The
+ * cache keeps the latest [topic][body...] per topic; when a subscription arrives on the backend, every
+ * cached topic it covers is sent straight away.  An optional ROUTER endpoint serves the same state in
+ * bulk (see fetch_snapshot()):
+ *   client -> cache: [prefix]
+ *   cache -> client: [topic][body...] for every cached topic starting with prefix, then [SNAPSHOT_END]
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include "prefix_trie.h"
+#include "../socket.h"
+#include "../messages/message.h"
+
+namespace zmqcpp
+{
+    class LastValueCache
+    {
+      public:
+        // the one-frame message that ends a snapshot (topics can't be exactly this)
+        static const std::string SNAPSHOT_END;
+
+      private:
+        struct entry
+        {
+            Message msg;
+            size_t bytes;
+            // this entry's place in m_lru
+            std::list<const std::string *>::iterator lru;
+        };
+
+        Socket m_front, m_back, m_snap;
+        bool m_has_snap;
+        std::unordered_map<std::string, entry> m_cache;
+        // the same entries by topic, for replaying every topic under a prefix (map nodes don't move)
+        PrefixTrie<entry *> m_index;
+        // topics, most recently updated first
+        std::list<const std::string *> m_lru;
+        size_t m_bytes, m_max_bytes;
+        Message m_in;
+        std::string m_key;
+        uint64_t m_updates, m_replayed, m_evicted;
+
+        void update();
+        void subscribed();
+        void snapshot();
+        void evict();
+
+      public:
+        /*!
+         * \brief Constructor
+         * \pre None
+         * \post the cache is bound to its endpoints (snapshot may be empty for none) and subscribed to
+         *       everything published to the frontend; it holds at most about max_bytes of messages
+         */
+        LastValueCache (const std::string &frontend, const std::string &backend, const std::string &snapshot = "",
+                        const size_t max_bytes = 64 * 1024 * 1024);
+
+        /*!
+         * \brief waits up to timeout_ms for traffic and handles everything that is waiting
+         * \pre None
+         * \post updates are cached and forwarded, new subscriptions have had their topics replayed,
+         *       and snapshot requests have been answered
+         * \returns whether anything was handled
+         *
+         * A replay goes out on the XPUB socket, so existing subscribers to the same topics see it again
+         */
+        bool serve_once (const long timeout_ms = -1);
+
+        /*!
+         * \brief the number of cached topics, and the bytes their messages take up
+         * \pre None
+         * \post None
+         * \returns the count
+         */
+        size_t size() const
+        {
+            return m_cache.size();
+        }
+        size_t bytes() const
+        {
+            return m_bytes;
+        }
+        /*!
+         * \brief counters: updates cached, messages replayed to new subscribers, topics evicted for space
+         * \pre None
+         * \post None
+         * \returns the count
+         */
+        uint64_t updates() const
+        {
+            return m_updates;
+        }
+        uint64_t replayed() const
+        {
+            return m_replayed;
+        }
+        uint64_t evicted() const
+        {
+            return m_evicted;
+        }
+    };
+
+    /*!
+     * \brief fetches every cached message whose topic starts with prefix from a LastValueCache's snapshot endpoint
+     * \pre fn is callable as void fn (Message &msg); msg is reused for the next message
+     * \post fn has seen each cached [topic][body...] in topic byte order
+     * \returns false if the cache didn't finish answering within timeout_ms of its last message
+     *          (the socket is dropped, so a late answer can't confuse the next fetch)
+     */
+    bool fetch_snapshot (const std::string &endpt, const std::string &prefix, std::function<void (Message &)> fn,
+                         const long timeout_ms = 1000);
+}
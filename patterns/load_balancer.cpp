@@ -0,0 +1,212 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file load_balancer.cpp
+ * \author Nathan Eloe
+ * \brief Implementation of the least-outstanding-requests broker
+ */
+
+#include "load_balancer.h"
+#include <cerrno>
+#include <cstring>
+
+namespace zmqcpp
+{
+    const std::string LoadBalancer::READY ("\x01", 1);
+    const std::string LoadBalancer::HEARTBEAT ("\x02", 1);
+    const size_t LoadBalancer::NO_WORKER;
+
+    LoadBalancer::LoadBalancer (const std::string &frontend, const std::string &backend, const std::chrono::milliseconds expiry,
+                                const uint32_t max_inflight):
+        m_front (ZMQ_ROUTER), m_back (ZMQ_ROUTER), m_expiry (expiry), m_stats (), m_max_inflight (max_inflight), m_rr (0)
+    {
+        m_front.bind (frontend);
+        m_front._bind();
+        // sends to a worker whose connection has gone fail instead of vanishing (see from_client())
+        m_back.setsockopt (ZMQ_ROUTER_MANDATORY, 1);
+        m_back.bind (backend);
+        m_back._bind();
+    }
+
+    size_t LoadBalancer::find (const const_buffer &id) const
+    {
+        for (size_t i = 0; i < m_workers.size(); i++)
+            if (m_workers[i].id.size() == id.size && !memcmp (m_workers[i].id.data(), id.data, id.size))
+                return i;
+        return NO_WORKER;
+    }
+
+    size_t LoadBalancer::admit (const const_buffer &id, const std::chrono::steady_clock::time_point now)
+    {
+        size_t w = find (id);
+        if (w == NO_WORKER)
+        {
+            m_workers.push_back ({std::string (static_cast<const char *> (id.data), id.size), 0, 0, now});
+            w = m_workers.size() - 1;
+        }
+        m_workers[w].last_seen = now;
+        return w;
+    }
+
+    bool LoadBalancer::available() const
+    {
+        for (const worker &w : m_workers)
+            if (!m_max_inflight || w.outstanding < m_max_inflight)
+                return true;
+        return false;
+    }
+
+    size_t LoadBalancer::least_outstanding()
+    {
+        const size_t n = m_workers.size();
+        size_t best = NO_WORKER;
+        for (size_t k = 0; k < n; k++)
+        {
+            const size_t i = (m_rr + k) % n;
+            if (m_max_inflight && m_workers[i].outstanding >= m_max_inflight)
+                continue;
+            if (best == NO_WORKER || m_workers[i].outstanding < m_workers[best].outstanding)
+                best = i;
+        }
+        m_rr = n ? (m_rr + 1) % n : 0;
+        return best;
+    }
+
+    size_t LoadBalancer::select (const EnvelopeMessage &)
+    {
+        return least_outstanding();
+    }
+
+    bool LoadBalancer::serve_once (const long timeout_ms)
+    {
+        expire();
+        zmq_pollitem_t items[] =
+        {
+            {(void *) m_back.raw_sock(), 0, ZMQ_POLLIN, 0},
+            {(void *) m_front.raw_sock(), 0, ZMQ_POLLIN, 0}
+        };
+        // with no worker free, requests wait in libzmq (and push back on clients) rather than in the broker
+        const bool room = available();
+        if (zmq::poll (items, room ? 2 : 1, timeout_ms) <= 0)
+            return false;
+        if (items[0].revents & ZMQ_POLLIN)
+            from_worker();
+        if (room && (items[1].revents & ZMQ_POLLIN))
+            from_client();
+        return true;
+    }
+
+    void LoadBalancer::from_worker()
+    {
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        while (m_back.recv_into (m_rep, ZMQ_DONTWAIT))
+        {
+            if (!m_rep.hops())
+            {
+                // no empty frame: [worker id][signal]
+                const const_buffer id = m_rep.view (0), sig = m_rep.view (1);
+                const bool ready = sig.size == 1 && !memcmp (sig.data, READY.data(), 1);
+                if (!ready && ! (sig.size == 1 && !memcmp (sig.data, HEARTBEAT.data(), 1)))
+                    continue;
+                // a heartbeat from a worker that was expired (e.g. it stalled for a while) brings it back
+                const size_t w = admit (id, now);
+                // a worker that (re)starts has forgotten whatever it was given
+                if (ready)
+                {
+                    m_stats.lost += m_workers[w].outstanding;
+                    m_workers[w].outstanding = 0;
+                }
+                m_workers[w].last_seen = now;
+                continue;
+            }
+            // [worker id][client envelope][body]: strip the worker and pass the rest back
+            worker &wk = m_workers[admit (m_rep.hop_view (0), now)];
+            if (wk.outstanding)
+                wk.outstanding--;
+            wk.served++;
+            m_rep.pop_hop();
+            m_front.send (m_rep, ZMQ_DONTWAIT);
+            m_stats.replies++;
+        }
+    }
+
+    void LoadBalancer::from_client()
+    {
+        while (available() && m_front.recv_into (m_req, ZMQ_DONTWAIT))
+        {
+            m_stats.requests++;
+            // workers that turn this request away sit it out, so select() can't pick them again
+            std::vector<worker> full;
+            bool tried = false, sent = false;
+            while (!sent && !m_workers.empty())
+            {
+                const size_t w = select (m_req);
+                if (w == NO_WORKER)
+                    break;
+                tried = true;
+                m_req.push_hop (m_workers[w].id);
+                try
+                {
+                    sent = m_back.send (m_req, ZMQ_DONTWAIT);
+                }
+                catch (const zmq::error_t &e)
+                {
+                    // ROUTER_MANDATORY: the worker disconnected before it could be expired
+                    if (e.num() != EHOSTUNREACH)
+                        throw;
+                    m_req.pop_hop();
+                    m_stats.lost += m_workers[w].outstanding;
+                    m_workers.erase (m_workers.begin() + w);
+                    continue;
+                }
+                if (sent)
+                    m_workers[w].outstanding++;
+                else
+                {
+                    // at its high-water mark
+                    m_req.pop_hop();
+                    full.push_back (std::move (m_workers[w]));
+                    m_workers.erase (m_workers.begin() + w);
+                }
+            }
+            m_workers.insert (m_workers.end(), full.begin(), full.end());
+            if (sent)
+                continue;
+            if (tried)
+                m_stats.lost++;
+            else
+                m_stats.unrouted++;
+        }
+    }
+
+    void LoadBalancer::expire()
+    {
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < m_workers.size();)
+        {
+            if (now - m_workers[i].last_seen <= m_expiry)
+            {
+                i++;
+                continue;
+            }
+            m_stats.expired++;
+            m_stats.lost += m_workers[i].outstanding;
+            m_workers.erase (m_workers.begin() + i);
+        }
+    }
+}
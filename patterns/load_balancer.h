@@ -0,0 +1,155 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file load_balancer.h
+ * \author Nathan Eloe
+ * \brief A ROUTER/ROUTER broker that sends each request to the worker with the fewest in flight
+ *
+ * Clients are REQ sockets (or DEALERs that put an empty frame ahead of the body) on the frontend.
+ * Workers are DEALER sockets on the backend:
+ *   worker -> broker: [READY]                   (joins, or rejoins with nothing in flight)
+ *                     [HEARTBEAT]               (still alive; any reply counts too)
+ *                     [client envelope][body]   (a reply, envelope sent back as received)
+ *   broker -> worker: [client envelope][body]   (a request; the envelope ends with an empty frame)
+ * Workers not heard from for the expiry time are dropped, along with whatever they had in flight; one
+ * that was only stalled is taken back on its next heartbeat or reply.  The backend is ROUTER_MANDATORY,
+ * so a request to a worker whose connection is gone counts as lost (and drops the worker) at once.
+ * With a per-worker in-flight limit, requests beyond it wait in libzmq until a worker frees up, so a
+ * slow worker can't collect a backlog that a fast one would have cleared.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "../socket.h"
+#include "../messages/envelope.h"
+
+namespace zmqcpp
+{
+    class LoadBalancer
+    {
+      public:
+        static const std::string READY, HEARTBEAT;
+        static const size_t NO_WORKER = static_cast<size_t> (-1);
+
+        /*!
+         * \brief One worker's state, as kept in the broker's flat worker list
+         */
+        struct worker
+        {
+            std::string id;
+            uint32_t outstanding;  // requests sent and not yet answered
+            uint64_t served;       // replies passed back
+            std::chrono::steady_clock::time_point last_seen;
+        };
+
+        /*!
+         * \brief Counters kept by the broker
+         */
+        struct lb_stats
+        {
+            uint64_t requests;
+            uint64_t replies;
+            uint64_t expired;   // workers dropped for missing their heartbeats
+            uint64_t lost;      // requests in flight to a worker when it was dropped or restarted, or that no worker took
+            uint64_t unrouted;  // requests select() found no worker for
+        };
+
+      private:
+        Socket m_front, m_back;
+        std::chrono::milliseconds m_expiry;
+        EnvelopeMessage m_req, m_rep;
+        lb_stats m_stats;
+
+        size_t find (const const_buffer &id) const;
+        // the worker with this id, added if it isn't known (or was expired), marked as seen now
+        size_t admit (const const_buffer &id, const std::chrono::steady_clock::time_point now);
+        bool available() const;
+        void from_worker();
+        void from_client();
+        void expire();
+
+      protected:
+        std::vector<worker> m_workers;
+        uint32_t m_max_inflight;
+        // where least_outstanding() starts looking, so ties are spread around
+        size_t m_rr;
+
+        /*!
+         * \brief the live worker with the fewest requests in flight
+         * \pre None
+         * \post None
+         * \returns its index in m_workers, or NO_WORKER if every worker is at the in-flight limit
+         */
+        size_t least_outstanding();
+        /*!
+         * \brief picks the worker a request goes to
+         * \pre m_workers isn't empty
+         * \post None
+         * \returns an index into m_workers, or NO_WORKER to drop the request
+         *
+         * Override to route differently; this one calls least_outstanding().  If the pick can't be sent to
+         * (it disconnected, or its pipe is full), select() is called again without it in m_workers
+         */
+        virtual size_t select (const EnvelopeMessage &req);
+
+      public:
+        /*!
+         * \brief Constructor
+         * \pre None
+         * \post the broker will bind frontend (for clients) and backend (for workers); each worker is given
+         *       at most max_inflight requests at once (0: no limit)
+         */
+        LoadBalancer (const std::string &frontend, const std::string &backend,
+                      const std::chrono::milliseconds expiry = std::chrono::milliseconds (3000), const uint32_t max_inflight = 0);
+        virtual ~LoadBalancer() {}
+
+        /*!
+         * \brief waits up to timeout_ms for traffic and handles everything that is waiting
+         * \pre None
+         * \post worker signals and replies are handled, requests are passed to workers, and silent workers
+         *       are dropped; requests are only taken off the frontend while some worker has room for them
+         * \returns whether anything was handled
+         */
+        bool serve_once (const long timeout_ms = -1);
+
+        /*!
+         * \brief the live workers, with their queue depths and reply counts
+         * \pre None
+         * \post None
+         * \returns the worker list
+         */
+        const std::vector<worker> &workers() const
+        {
+            return m_workers;
+        }
+        /*!
+         * \brief the counters
+         * \pre None
+         * \post None
+         * \returns the stats
+         */
+        const lb_stats &stats() const
+        {
+            return m_stats;
+        }
+    };
+}
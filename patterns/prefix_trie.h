@@ -0,0 +1,328 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file prefix_trie.h
+ * \author Nathan Eloe
+ * \brief A radix tree keyed by byte strings, with longest-prefix lookup
+ *
+ * Nodes live in one vector and refer to each other by index.  Each node holds the edge label leading
+ * to it and its children sorted by their first byte, so a lookup costs O(key length) no matter how
+ * many keys the tree holds.  Erasing unlinks nodes left empty and merges single-child chains back
+ * together, and freed nodes are reused, so a tree with churning keys stays the size of its live set.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace zmqcpp
+{
+    template <class V>
+    class PrefixTrie
+    {
+      private:
+        struct node
+        {
+            std::string label;
+            // (first byte of the child's label, child index), sorted by byte
+            std::vector<std::pair<unsigned char, uint32_t>> kids;
+            bool has;
+            V value;
+        };
+        std::vector<node> m_nodes;
+        std::vector<uint32_t> m_free;
+        size_t m_size;
+        static const uint32_t NONE = UINT32_MAX;
+
+        // the child of n whose label starts with b, or 0 (the root is never anyone's child)
+        uint32_t kid (const uint32_t n, const unsigned char b) const
+        {
+            const std::vector<std::pair<unsigned char, uint32_t>> &kids = m_nodes[n].kids;
+            auto it = std::lower_bound (kids.begin(), kids.end(), std::make_pair (b, static_cast<uint32_t> (0)));
+            return (it != kids.end() && it->first == b) ? it->second : 0;
+        }
+        uint32_t add_node (const std::string &label)
+        {
+            if (m_free.size())
+            {
+                const uint32_t n = m_free.back();
+                m_free.pop_back();
+                m_nodes[n].label = label;
+                return n;
+            }
+            m_nodes.push_back (node());
+            m_nodes.back().label = label;
+            m_nodes.back().has = false;
+            return m_nodes.size() - 1;
+        }
+        void free_node (const uint32_t n)
+        {
+            node &nd = m_nodes[n];
+            nd.label.clear();
+            nd.kids.clear();
+            nd.has = false;
+            nd.value = V();
+            m_free.push_back (n);
+        }
+        // folds n's only child into n, which keeps its index (and so its place in its parent)
+        void merge (const uint32_t n)
+        {
+            const uint32_t c = m_nodes[n].kids[0].second;
+            node &top = m_nodes[n], &bottom = m_nodes[c];
+            top.label += bottom.label;
+            top.kids.swap (bottom.kids);
+            top.has = bottom.has;
+            std::swap (top.value, bottom.value);
+            free_node (c);
+        }
+        void add_kid (const uint32_t n, const uint32_t k)
+        {
+            std::vector<std::pair<unsigned char, uint32_t>> &kids = m_nodes[n].kids;
+            const std::pair<unsigned char, uint32_t> entry (m_nodes[k].label[0], k);
+            kids.insert (std::lower_bound (kids.begin(), kids.end(), entry), entry);
+        }
+        // the node whose path spells exactly key, or NONE if there isn't one; parent gets the node above it
+        uint32_t find_node (const char *key, const size_t size, uint32_t *parent = nullptr) const
+        {
+            uint32_t n = 0, up = NONE;
+            size_t pos = 0;
+            while (true)
+            {
+                const std::string &label = m_nodes[n].label;
+                if (label.size() > size - pos || memcmp (label.data(), key + pos, label.size()))
+                    return NONE;
+                pos += label.size();
+                if (pos == size)
+                {
+                    if (parent)
+                        *parent = up;
+                    return n;
+                }
+                up = n;
+                if (! (n = kid (n, key[pos])))
+                    return NONE;
+            }
+        }
+        // calls fn (key, value) for n and everything below it, children in byte order
+        template <class F>
+        void visit (const uint32_t n, std::string &key, F &fn) const
+        {
+            const node &nd = m_nodes[n];
+            if (nd.has)
+                fn (static_cast<const std::string &> (key), nd.value);
+            for (const std::pair<unsigned char, uint32_t> &k : nd.kids)
+            {
+                const size_t at = key.size();
+                key += m_nodes[k.second].label;
+                visit (k.second, key, fn);
+                key.resize (at);
+            }
+        }
+
+      public:
+        /*!
+         * \brief Constructor
+         * \pre None
+         * \post the trie is empty
+         */
+        PrefixTrie(): m_size (0)
+        {
+            add_node ("");
+        }
+
+        /*!
+         * \brief stores val under key, replacing what was there
+         * \pre None
+         * \post find (key) returns val
+         * \returns true if key is new
+         */
+        bool insert (const std::string &key, const V &val)
+        {
+            uint32_t n = 0;
+            size_t pos = 0;
+            while (true)
+            {
+                const std::string &label = m_nodes[n].label;
+                size_t common = 0;
+                while (common < label.size() && pos + common < key.size() && label[common] == key[pos + common])
+                    common++;
+                if (common < label.size())
+                {
+                    // the key leaves this edge part way along: split it, keeping the tail as a child
+                    const uint32_t tail = add_node (m_nodes[n].label.substr (common));
+                    node &top = m_nodes[n], &bottom = m_nodes[tail];
+                    bottom.kids.swap (top.kids);
+                    std::swap (bottom.has, top.has);
+                    std::swap (bottom.value, top.value);
+                    top.label.resize (common);
+                    top.value = V();
+                    add_kid (n, tail);
+                }
+                pos += common;
+                if (pos == key.size())
+                    break;
+                const uint32_t next = kid (n, key[pos]);
+                if (!next)
+                {
+                    const uint32_t leaf = add_node (key.substr (pos));
+                    add_kid (n, leaf);
+                    n = leaf;
+                    break;
+                }
+                n = next;
+            }
+            const bool added = !m_nodes[n].has;
+            m_nodes[n].has = true;
+            m_nodes[n].value = val;
+            m_size += added;
+            return added;
+        }
+
+        /*!
+         * \brief removes key
+         * \pre None
+         * \post find (key) returns nullptr; nodes no longer needed are recycled
+         * \returns true if key was there
+         */
+        bool erase (const std::string &key)
+        {
+            uint32_t p;
+            const uint32_t n = find_node (key.data(), key.size(), &p);
+            if (n == NONE || !m_nodes[n].has)
+                return false;
+            m_nodes[n].has = false;
+            m_nodes[n].value = V();
+            m_size--;
+            if (!n)
+                return true;
+            if (m_nodes[n].kids.empty())
+            {
+                std::vector<std::pair<unsigned char, uint32_t>> &kids = m_nodes[p].kids;
+                kids.erase (std::lower_bound (kids.begin(), kids.end(),
+                                              std::make_pair (static_cast<unsigned char> (m_nodes[n].label[0]), static_cast<uint32_t> (0))));
+                free_node (n);
+                // the parent may now be a pass-through node with one child
+                if (p && !m_nodes[p].has && m_nodes[p].kids.size() == 1)
+                    merge (p);
+            }
+            else if (m_nodes[n].kids.size() == 1)
+                merge (n);
+            return true;
+        }
+
+        ///@{
+        /*!
+         * \brief exact lookup
+         * \pre None
+         * \post None
+         * \returns the value stored under key, or nullptr
+         */
+        const V *find (const std::string &key) const
+        {
+            const uint32_t n = find_node (key.data(), key.size());
+            return (n != NONE && m_nodes[n].has) ? &m_nodes[n].value : nullptr;
+        }
+        V *find (const std::string &key)
+        {
+            return const_cast<V *> (static_cast<const PrefixTrie *> (this)->find (key));
+        }
+        ///@}
+
+        ///@{
+        /*!
+         * \brief longest-prefix lookup
+         * \pre None
+         * \post None
+         * \returns the value of the longest stored key that is a prefix of data, or nullptr
+         */
+        const V *longest_match (const char *data, const size_t size) const
+        {
+            const V *best = nullptr;
+            uint32_t n = 0;
+            size_t pos = 0;
+            while (true)
+            {
+                const node &nd = m_nodes[n];
+                if (nd.label.size() > size - pos || memcmp (nd.label.data(), data + pos, nd.label.size()))
+                    return best;
+                pos += nd.label.size();
+                if (nd.has)
+                    best = &nd.value;
+                if (pos == size || ! (n = kid (n, data[pos])))
+                    return best;
+            }
+        }
+        V *longest_match (const char *data, const size_t size)
+        {
+            return const_cast<V *> (static_cast<const PrefixTrie *> (this)->longest_match (data, size));
+        }
+        const V *longest_match (const std::string &key) const
+        {
+            return longest_match (key.data(), key.size());
+        }
+        V *longest_match (const std::string &key)
+        {
+            return longest_match (key.data(), key.size());
+        }
+        ///@}
+
+        /*!
+         * \brief visits every key that starts with prefix
+         * \pre fn is callable as fn (const std::string &key, const V &value), and doesn't change the trie
+         * \post fn has been called once per matching key, in byte order
+         */
+        template <class F>
+        void visit_prefix (const std::string &prefix, F fn) const
+        {
+            std::string key;
+            uint32_t n = 0;
+            size_t pos = 0;
+            while (true)
+            {
+                const std::string &label = m_nodes[n].label;
+                // the prefix may end part way along an edge
+                const size_t len = std::min (label.size(), prefix.size() - pos);
+                if (memcmp (label.data(), prefix.data() + pos, len))
+                    return;
+                key += label;
+                pos += len;
+                if (pos == prefix.size())
+                    break;
+                if (! (n = kid (n, prefix[pos])))
+                    return;
+            }
+            visit (n, key, fn);
+        }
+
+        /*!
+         * \brief the number of keys stored
+         * \pre None
+         * \post None
+         * \returns the key count
+         */
+        size_t size() const
+        {
+            return m_size;
+        }
+    };
+}
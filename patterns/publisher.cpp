@@ -0,0 +1,68 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file publisher.cpp
+ * \author Nathan Eloe
+ * \brief Implementation of the subscription-aware publisher
+ */
+
+#include "publisher.h"
+
+namespace zmqcpp
+{
+    Publisher::Publisher (const std::string &endpt): m_sock (ZMQ_XPUB), m_published (0), m_skipped (0)
+    {
+        m_sock.bind (endpt);
+    }
+
+    size_t Publisher::update()
+    {
+        size_t changes = 0;
+        std::string prefix;
+        bool sub = false, seen = false;
+        // the first frame is [1 or 0][prefix]; anything else a peer sends is dropped
+        auto take = [&] (const const_buffer & f, bool) -> frame_act
+        {
+            const char *data = static_cast<const char *> (f.data);
+            seen = f.size && (data[0] == 0 || data[0] == 1);
+            if (seen)
+            {
+                sub = data[0] == 1;
+                prefix.assign (data + 1, f.size - 1);
+            }
+            return FRAME_SKIP;
+        };
+        while (m_sock.recv_frames (take, ZMQ_DONTWAIT))
+        {
+            if (!seen)
+                continue;
+            changes++;
+            size_t *count = m_subs.find (prefix);
+            if (sub)
+            {
+                if (count)
+                    (*count)++;
+                else
+                    m_subs.insert (prefix, 1);
+            }
+            else if (count && ! --*count)
+                m_subs.erase (prefix);
+        }
+        return changes;
+    }
+}
@@ -0,0 +1,130 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file publisher.h
+ * \author Nathan Eloe
+ * \brief An XPUB publisher that only builds messages somebody has subscribed to
+ *
+ * XPUB hands the publisher every subscribe ([1][prefix]) and unsubscribe ([0][prefix]) its peers send.
+ * Publisher keeps the live prefixes in a PrefixTrie, so before building a message it can check in
+ * O(topic length) whether any subscriber would get it, and skip the work if not.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include "prefix_trie.h"
+#include "../socket.h"
+#include "../messages/message.h"
+
+namespace zmqcpp
+{
+    class Publisher
+    {
+      private:
+        Socket m_sock;
+        // live prefixes, with how many subscribe frames each has had net of unsubscribes
+        PrefixTrie<size_t> m_subs;
+        uint64_t m_published, m_skipped;
+
+      public:
+        /*!
+         * \brief Constructor
+         * \pre None
+         * \post the publisher will bind to endpt (as an XPUB socket)
+         */
+        Publisher (const std::string &endpt);
+
+        /*!
+         * \brief reads the subscription changes that have arrived since the last call
+         * \pre None
+         * \post the live prefixes reflect every subscribe and unsubscribe libzmq has passed on
+         * \returns the number of changes read
+         */
+        size_t update();
+        /*!
+         * \brief whether any subscriber would receive a message on topic
+         * \pre None
+         * \post None (call update() first for an up-to-date answer)
+         * \returns true if a live prefix is a prefix of topic
+         */
+        bool wanted (const std::string &topic) const
+        {
+            return m_subs.longest_match (topic) != nullptr;
+        }
+
+        /*!
+         * \brief publishes a message on topic, building its body only if a subscriber wants it
+         * \pre produce is callable as void produce (Message &body)
+         * \post if some subscriber matches topic, produce has added the body frames and [topic][body...] has been sent;
+         *       otherwise produce was never called
+         * \returns whether the message was built and sent (or queued)
+         */
+        template <class F>
+        bool publish (const std::string &topic, F produce, const int opts = 0)
+        {
+            update();
+            if (!wanted (topic))
+            {
+                m_skipped++;
+                return false;
+            }
+            Message msg;
+            msg.add_frame (topic);
+            produce (msg);
+            m_published++;
+            return m_sock.send (msg, opts);
+        }
+
+        /*!
+         * \brief the number of live prefixes
+         * \pre None
+         * \post None
+         * \returns the subscription count
+         */
+        size_t subscriptions() const
+        {
+            return m_subs.size();
+        }
+        /*!
+         * \brief how many publish() calls built a message, and how many were skipped for want of a subscriber
+         * \pre None
+         * \post None
+         * \returns the count
+         */
+        uint64_t published() const
+        {
+            return m_published;
+        }
+        uint64_t skipped() const
+        {
+            return m_skipped;
+        }
+        /*!
+         * \brief the socket underneath
+         * \pre None
+         * \post None
+         * \returns the Socket
+         */
+        Socket &socket()
+        {
+            return m_sock;
+        }
+    };
+}
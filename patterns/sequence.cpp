@@ -0,0 +1,89 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file sequence.cpp
+ * \author Nathan Eloe
+ * \brief Implementation of the sequence stamping publisher and the gap tracker
+ */
+
+#include "sequence.h"
+#include <random>
+
+namespace zmqcpp
+{
+    const uint64_t SeqTracker::WINDOW;
+
+    SeqPublisher::SeqPublisher (Socket &sock, const seq_scope scope, const uint32_t id): m_sock (sock), m_next (0)
+    {
+        uint32_t pub = id;
+        while (!pub)
+            pub = std::random_device()();
+        m_head.set<0> (pub);
+        m_head.set<1> (scope);
+    }
+
+    seq_event SeqTracker::track (const const_buffer &topic, const const_buffer &seq)
+    {
+        seq_header head;
+        if (!head.decode (seq))
+        {
+            m_stats.unsequenced++;
+            return SEQ_UNSEQUENCED;
+        }
+        const uint32_t id = head.get<0>();
+        const uint64_t n = head.get<2>();
+        // the stream is the publisher id, followed by the topic if it numbers topics separately
+        m_key.assign (reinterpret_cast<const char *> (&id), sizeof (id));
+        if (head.get<1>() == SEQ_PER_TOPIC)
+            m_key.append (static_cast<const char *> (topic.data), topic.size);
+        m_stats.received++;
+
+        auto it = m_streams.find (m_key);
+        if (it == m_streams.end())
+        {
+            // whatever came before the first one we see is too old to tell apart from a duplicate
+            m_streams[m_key] = {n + 1, ~0ull};
+            return SEQ_IN_ORDER;
+        }
+        stream &s = it->second;
+        if (n >= s.next)
+        {
+            const uint64_t skipped = n - s.next;
+            s.seen = (skipped + 1 < WINDOW) ? ((s.seen << (skipped + 1)) | 1) : 1;
+            const uint64_t first = s.next;
+            s.next = n + 1;
+            if (!skipped)
+                return SEQ_IN_ORDER;
+            m_stats.gaps++;
+            m_stats.missing += skipped;
+            if (m_on_gap)
+                m_on_gap (id, head.get<1>() == SEQ_PER_TOPIC ? m_key.substr (sizeof (id)) : std::string(), first, skipped);
+            return SEQ_GAP;
+        }
+        const uint64_t back = s.next - 1 - n;
+        if (back >= WINDOW || (s.seen & (1ull << back)))
+        {
+            m_stats.duplicates++;
+            return SEQ_DUPLICATE;
+        }
+        s.seen |= 1ull << back;
+        m_stats.late++;
+        m_stats.missing--;
+        return SEQ_LATE;
+    }
+}
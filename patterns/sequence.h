@@ -0,0 +1,197 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file sequence.h
+ * \author Nathan Eloe
+ * \brief Sequence numbers on pub/sub streams, so subscribers can see what they missed
+ *
+ * SeqPublisher sends [topic][seq][body...], where seq is a seq_header: the publisher's id, whether
+ * the numbering is per topic or shared by all of its topics, and the sequence number.  SeqTracker
+ * follows each stream (a publisher, or a publisher's topic) and sorts every message into in order,
+ * after a gap, a duplicate, or a late arrival that fills an earlier gap.  A PUB socket that hits its
+ * high water mark drops silently; with sequencing on, those drops show up as gaps.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include "../socket.h"
+#include "../messages/header.h"
+#include "../messages/message.h"
+
+namespace zmqcpp
+{
+    // [publisher id][per-topic numbering?][sequence number]
+    typedef Header<field<uint32_t>, field<uint8_t>, field<uint64_t>> seq_header;
+
+    enum seq_scope
+    {
+        SEQ_PER_PUBLISHER,  // one counter for everything the publisher sends
+        SEQ_PER_TOPIC       // a counter per topic
+    };
+
+    class SeqPublisher
+    {
+      private:
+        Socket &m_sock;
+        seq_header m_head;
+        uint64_t m_next;
+        std::unordered_map<std::string, uint64_t> m_topic_next;
+
+      public:
+        /*!
+         * \brief Constructor
+         * \pre sock outlives the publisher
+         * \post messages sent through the publisher go out on sock stamped with id; id 0 picks a random one
+         *
+         * Give every run of a publisher a new id: a tracker that sees a known id start over counts duplicates
+         */
+        SeqPublisher (Socket &sock, const seq_scope scope = SEQ_PER_PUBLISHER, const uint32_t id = 0);
+
+        /*!
+         * \brief sends [topic][seq][body...]
+         * \pre None
+         * \post on success the stream's sequence number has moved on; a send that fails doesn't use one up
+         * \returns Whether the message was sent or queued
+         */
+        template <class T>
+        bool send (const std::string &topic, const BaseMessage<T> &body, const int opts = 0)
+        {
+            uint64_t &next = (m_head.get<1>() == SEQ_PER_TOPIC) ? m_topic_next[topic] : m_next;
+            m_head.set<2> (next);
+            Message msg;
+            msg.add_frame (topic);
+            msg.add_frame (m_head);
+            msg.share_frames (body);
+            if (!m_sock.send (msg, opts))
+                return false;
+            next++;
+            return true;
+        }
+
+        /*!
+         * \brief the id this publisher stamps on its messages
+         * \pre None
+         * \post None
+         * \returns the id
+         */
+        uint32_t id() const
+        {
+            return m_head.get<0>();
+        }
+    };
+
+    /*!
+     * \brief What SeqTracker::track() made of a message
+     */
+    enum seq_event
+    {
+        SEQ_IN_ORDER,     // the next one expected (or the first of its stream)
+        SEQ_GAP,          // newer than expected: the ones in between are missing
+        SEQ_DUPLICATE,    // seen before (or too old to tell)
+        SEQ_LATE,         // older than expected but not seen before: it fills part of an earlier gap
+        SEQ_UNSEQUENCED   // no valid seq frame
+    };
+
+    /*!
+     * \brief Counters kept by SeqTracker
+     */
+    struct seq_stats
+    {
+        uint64_t received;     // sequenced messages tracked
+        uint64_t gaps;         // times a stream skipped ahead
+        uint64_t missing;      // messages skipped and not (yet) filled in by late ones
+        uint64_t duplicates;
+        uint64_t late;
+        uint64_t unsequenced;
+    };
+
+    class SeqTracker
+    {
+      public:
+        /*!
+         * \brief told about each gap: the stream's publisher and topic ("" for per-publisher numbering),
+         *        and the first missing sequence number and how many are missing
+         */
+        typedef std::function<void (uint32_t id, const std::string &topic, uint64_t first, uint64_t count)> gap_fn;
+        // how far back the tracker remembers which sequence numbers it has seen
+        static const uint64_t WINDOW = 64;
+
+      private:
+        struct stream
+        {
+            uint64_t next;
+            // bit i set: next - 1 - i has been seen
+            uint64_t seen;
+        };
+        std::unordered_map<std::string, stream> m_streams;
+        std::string m_key;
+        gap_fn m_on_gap;
+        seq_stats m_stats;
+
+      public:
+        /*!
+         * \brief Constructor
+         * \pre None
+         * \post the tracker knows no streams; on_gap (if any) is called for every gap found
+         */
+        SeqTracker (gap_fn on_gap = nullptr): m_on_gap (on_gap), m_stats () {}
+
+        /*!
+         * \brief classifies one message by its topic and seq frames
+         * \pre None
+         * \post the stream's state and the counters are updated, and on_gap has been called for a gap
+         * \returns what the message was
+         */
+        seq_event track (const const_buffer &topic, const const_buffer &seq);
+        /*!
+         * \brief classifies a received [topic][seq][body...] message
+         * \pre None
+         * \post as for track (topic, seq)
+         * \returns what the message was
+         */
+        template <class T>
+        seq_event track (const BaseMessage<T> &msg)
+        {
+            return track (msg.view (0), msg.view (1));
+        }
+
+        /*!
+         * \brief the counters
+         * \pre None
+         * \post None
+         * \returns the stats
+         */
+        const seq_stats &stats() const
+        {
+            return m_stats;
+        }
+        /*!
+         * \brief forgets every stream (e.g. after a deliberate reconnect)
+         * \pre None
+         * \post the next message of every stream counts as its first; the counters are kept
+         */
+        void reset()
+        {
+            m_streams.clear();
+        }
+    };
+}
@@ -0,0 +1,222 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file stream.cpp
+ * \author Nathan Eloe
+ * \brief Implementation of the chunked stream sender and receiver
+ */
+
+#include "stream.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace zmqcpp
+{
+    namespace
+    {
+        void put_be (unsigned char *out, uint64_t v, const int bytes)
+        {
+            for (int i = bytes - 1; i >= 0; i--, v >>= 8)
+                out[i] = v & 0xff;
+        }
+        uint64_t get_be (const unsigned char *in, const int bytes)
+        {
+            uint64_t v = 0;
+            for (int i = 0; i < bytes; i++)
+                v = (v << 8) | in[i];
+            return v;
+        }
+        std::runtime_error sys_error (const std::string &what)
+        {
+            return std::runtime_error (what + ": " + strerror (errno));
+        }
+    }
+
+    StreamSender::StreamSender (const std::string &endpt, const std::string &path, const size_t chunk, const io_mode mode):
+        m_sock (ZMQ_ROUTER), m_fd (-1), m_size (0), m_chunk (chunk), m_map (nullptr)
+    {
+        if ((m_fd = open (path.c_str(), O_RDONLY)) < 0)
+            throw sys_error ("open " + path);
+        struct stat st;
+        if (fstat (m_fd, &st) < 0)
+        {
+            close (m_fd);
+            throw sys_error ("stat " + path);
+        }
+        m_size = st.st_size;
+        if (mode == MMAP && m_size)
+        {
+            void *base = mmap (nullptr, m_size, PROT_READ, MAP_SHARED, m_fd, 0);
+            if (base == MAP_FAILED)
+            {
+                close (m_fd);
+                throw sys_error ("mmap " + path);
+            }
+            madvise (base, m_size, MADV_SEQUENTIAL);
+            m_map = new mapping;
+            m_map->base = base;
+            m_map->len = m_size;
+            m_map->refs = 1;
+        }
+        m_sock.bind (endpt);
+        m_sock._bind();
+    }
+
+    StreamSender::~StreamSender()
+    {
+        close (m_fd);
+        if (m_map)
+            unref (nullptr, m_map);
+    }
+
+    void StreamSender::unref (void *data, void *hint)
+    {
+        mapping *m = static_cast<mapping *> (hint);
+        if (--m->refs == 0)
+        {
+            munmap (m->base, m->len);
+            delete m;
+        }
+    }
+
+    bool StreamSender::send_chunk (const std::string &id, const uint64_t index)
+    {
+        const uint64_t offset = index * m_chunk;
+        const size_t len = (offset < m_size) ? std::min<uint64_t> (m_chunk, m_size - offset) : 0;
+        zmq::message_t data;
+        if (len && m_map)
+        {
+            m_map->refs++;
+            data.rebuild (static_cast<char *> (m_map->base) + offset, len, unref, m_map);
+        }
+        else if (len)
+        {
+            data.rebuild (len);
+            for (size_t got = 0; got < len;)
+            {
+                const ssize_t n = pread (m_fd, static_cast<char *> (data.data()) + got, len - got, offset + got);
+                if (n <= 0)
+                    throw sys_error ("pread");
+                got += n;
+            }
+        }
+        unsigned char idx[8];
+        put_be (idx, index, 8);
+        m_sock.raw_sock().send (id.data(), id.size(), ZMQ_SNDMORE);
+        m_sock.raw_sock().send (idx, sizeof (idx), ZMQ_SNDMORE);
+        m_sock.raw_sock().send (data);
+        return len != 0;
+    }
+
+    bool StreamSender::serve_once (const long timeout_ms)
+    {
+        zmq_pollitem_t item = {(void *) m_sock.raw_sock(), 0, ZMQ_POLLIN, 0};
+        bool handled = false;
+        if (zmq::poll (&item, 1, timeout_ms) > 0)
+        {
+            zmq::message_t id, credit;
+            int more;
+            size_t msize = sizeof (more);
+            while (m_sock.raw_sock().recv (&id, ZMQ_DONTWAIT))
+            {
+                m_sock.raw_sock().recv (&credit);
+                m_sock.raw_sock().getsockopt (ZMQ_RCVMORE, &more, &msize);
+                // anything else that came along isn't ours to understand
+                while (more)
+                {
+                    m_sock.raw_sock().recv (&credit);
+                    m_sock.raw_sock().getsockopt (ZMQ_RCVMORE, &more, &msize);
+                }
+                const std::string who (static_cast<char *> (id.data()), id.size());
+                const unsigned char *c = static_cast<unsigned char *> (credit.data());
+                if (credit.size() == 12)
+                    m_peers[who] = {get_be (c + 4, 8), 0};
+                // top-ups for a stream that already ended are stale; drop them
+                else if (credit.size() != 4 || !m_peers.count (who))
+                    continue;
+                m_peers[who].credit += get_be (c, 4);
+                handled = true;
+            }
+        }
+        for (auto it = m_peers.begin(); it != m_peers.end();)
+        {
+            bool more = true;
+            for (; it->second.credit && more; it->second.credit--)
+                more = send_chunk (it->first, it->second.next++);
+            if (more)
+                ++it;
+            else
+                it = m_peers.erase (it);
+        }
+        return handled;
+    }
+
+    StreamReceiver::StreamReceiver (const std::string &endpt, const uint32_t credit):
+        m_sock (ZMQ_DEALER), m_credit (credit), m_next (0), m_pos (0), m_started (false), m_done (false)
+    {
+        m_sock.connect (endpt);
+    }
+
+    void StreamReceiver::grant (const uint32_t credit)
+    {
+        unsigned char c[12];
+        put_be (c, credit, 4);
+        put_be (c + 4, m_next, 8);
+        m_sock.raw_sock().send (c, m_started ? 4 : sizeof (c));
+    }
+
+    const_buffer StreamReceiver::next()
+    {
+        if (m_done)
+            return {nullptr, 0};
+        m_sock._conn();
+        // the chunk we are about to drop frees up one slot of credit
+        grant (m_started ? 1 : m_credit);
+        m_started = true;
+        zmq::message_t idx;
+        m_sock.raw_sock().recv (&idx);
+        m_sock.raw_sock().recv (&m_chunk);
+        m_pos = 0;
+        if (idx.size() != 8 || get_be (static_cast<unsigned char *> (idx.data()), 8) != m_next)
+            throw stream_error();
+        m_next++;
+        if (!m_chunk.size())
+            m_done = true;
+        return {m_chunk.data(), m_chunk.size()};
+    }
+
+    size_t StreamReceiver::read (char *buf, const size_t len)
+    {
+        size_t got = 0;
+        while (got < len)
+        {
+            if (m_pos == m_chunk.size() && !next().size)
+                break;
+            const size_t n = std::min (len - got, m_chunk.size() - m_pos);
+            memcpy (buf + got, static_cast<char *> (m_chunk.data()) + m_pos, n);
+            m_pos += n;
+            got += n;
+        }
+        return got;
+    }
+}
@@ -0,0 +1,169 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file stream.h
+ * \author Nathan Eloe
+ * \brief Chunked, credit-based transfer of large payloads over ROUTER/DEALER
+ *
+ * The receiver (DEALER) grants the sender (ROUTER) credit for a number of chunks; the sender only ever has
+ * that many chunks in flight to a receiver, so neither side holds more than credit * chunk bytes.
+ *
+ * Wire format:
+ *   receiver -> sender: [credit: u32 big-endian][first chunk: u64 big-endian]  (opens the stream)
+ *                       [credit: u32 big-endian]                              (tops up credit)
+ *   sender -> receiver: [chunk index: u64 big-endian][data]  (empty data marks the end of the stream)
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <map>
+#include <string>
+#include <zmq.hpp>
+#include "../socket.h"
+
+namespace zmqcpp
+{
+    class stream_error : public std::exception
+    {
+      public:
+        const char *what()
+        {
+            return "Stream chunk arrived out of order";
+        }
+    };
+
+    class StreamSender
+    {
+      public:
+        enum io_mode
+        {
+            PREAD,  // each chunk is pread straight into its zmq message
+            MMAP    // the file is mapped once and chunks are sent zero-copy out of the mapping
+        };
+
+      private:
+        struct peer
+        {
+            uint64_t next;
+            uint32_t credit;
+        };
+        // the mapping outlives the sender for as long as libzmq still holds chunks out of it
+        struct mapping
+        {
+            void *base;
+            size_t len;
+            std::atomic<long> refs;
+        };
+
+        Socket m_sock;
+        int m_fd;
+        uint64_t m_size;
+        size_t m_chunk;
+        mapping *m_map;
+        std::map<std::string, peer> m_peers;
+
+        static void unref (void *data, void *hint);
+        bool send_chunk (const std::string &id, const uint64_t index);
+
+      public:
+        /*!
+         * \brief Constructor
+         * \pre path names a readable regular file
+         * \post the sender is bound to endpt and ready to serve path in chunk-byte pieces
+         * \throws std::runtime_error if the file can't be opened (or mapped, in MMAP mode)
+         */
+        StreamSender (const std::string &endpt, const std::string &path, const size_t chunk = 256 * 1024, const io_mode mode = PREAD);
+        /*!
+         * \brief Destructor
+         * \pre None
+         * \post the file is closed; a mapping is released once libzmq lets go of its last chunk
+         */
+        ~StreamSender();
+        StreamSender (const StreamSender &) = delete;
+        StreamSender &operator= (const StreamSender &) = delete;
+
+        /*!
+         * \brief handles credit grants for up to timeout_ms and sends every chunk the receivers have credit for
+         * \pre None
+         * \post each receiver with credit has been sent chunks until its credit or the file ran out
+         * \returns whether any credit message was handled
+         */
+        bool serve_once (const long timeout_ms = -1);
+        /*!
+         * \brief the number of receivers currently being served
+         * \pre None
+         * \post None
+         * \returns the number of receivers that haven't reached the end of the file
+         */
+        size_t active() const
+        {
+            return m_peers.size();
+        }
+    };
+
+    class StreamReceiver
+    {
+      private:
+        Socket m_sock;
+        uint32_t m_credit;
+        uint64_t m_next;
+        zmq::message_t m_chunk;
+        size_t m_pos;
+        bool m_started, m_done;
+
+        void grant (const uint32_t credit);
+
+      public:
+        /*!
+         * \brief Constructor
+         * \pre credit > 0, and stays below the socket high water marks
+         * \post the receiver is connected to endpt; nothing is requested until the first read
+         */
+        StreamReceiver (const std::string &endpt, const uint32_t credit = 8);
+
+        /*!
+         * \brief gets the next chunk of the stream without copying it
+         * \pre None
+         * \post the previous chunk is released and one more chunk of credit is granted
+         * \returns a view of the chunk (valid until the next call), or an empty view at the end of the stream
+         * \throws stream_error if a chunk arrives out of order
+         */
+        const_buffer next();
+        /*!
+         * \brief copies up to len bytes of the stream into buf
+         * \pre None
+         * \post the stream position is advanced by the returned number of bytes
+         * \returns the number of bytes copied; 0 means the end of the stream
+         * \throws stream_error if a chunk arrives out of order
+         */
+        size_t read (char *buf, const size_t len);
+        /*!
+         * \brief whether the end of the stream has been reached
+         * \pre None
+         * \post None
+         * \returns true once the end-of-stream marker has been received
+         */
+        bool done() const
+        {
+            return m_done;
+        }
+    };
+}
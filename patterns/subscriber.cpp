@@ -0,0 +1,73 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file subscriber.cpp
+ * \author Nathan Eloe
+ * \brief Implementation of the prefix-dispatching subscriber
+ */
+
+#include "subscriber.h"
+
+namespace zmqcpp
+{
+    Subscriber::Subscriber (const std::string &endpt): m_sock (ZMQ_SUB), m_unmatched (0)
+    {
+        m_sock.connect (endpt);
+    }
+
+    void Subscriber::on (const std::string &prefix, const handler &fn)
+    {
+        // libzmq counts subscriptions, so only a new prefix gets one
+        if (m_handlers.insert (prefix, fn))
+        {
+            m_sock._conn();
+            m_sock.raw_sock().setsockopt (ZMQ_SUBSCRIBE, prefix.data(), prefix.size());
+        }
+    }
+
+    bool Subscriber::off (const std::string &prefix)
+    {
+        if (!m_handlers.erase (prefix))
+            return false;
+        m_sock._conn();
+        m_sock.raw_sock().setsockopt (ZMQ_UNSUBSCRIBE, prefix.data(), prefix.size());
+        return true;
+    }
+
+    size_t Subscriber::dispatch (const long timeout_ms)
+    {
+        m_sock._conn();
+        zmq_pollitem_t item = {(void *) m_sock.raw_sock(), 0, ZMQ_POLLIN, 0};
+        if (zmq::poll (&item, 1, timeout_ms) <= 0)
+            return 0;
+        size_t handled = 0;
+        while (m_sock.recv_into (m_msg, ZMQ_DONTWAIT))
+        {
+            const const_buffer topic = m_msg.front_view();
+            handler *fn = m_handlers.longest_match (static_cast<const char *> (topic.data), topic.size);
+            if (fn)
+            {
+                (*fn) (m_msg);
+                handled++;
+            }
+            else
+                m_unmatched++;
+        }
+        return handled;
+    }
+}
@@ -0,0 +1,114 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file subscriber.h
+ * \author Nathan Eloe
+ * \brief A SUB socket that routes each message to the handler of its longest matching topic prefix
+ *
+ * Registering a handler subscribes the socket to its prefix; the handlers live in a PrefixTrie, so
+ * finding the one for a message costs O(topic length) however many handlers there are.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include "prefix_trie.h"
+#include "../socket.h"
+#include "../messages/message.h"
+
+namespace zmqcpp
+{
+    class Subscriber
+    {
+      public:
+        typedef std::function<void (Message &)> handler;
+
+      private:
+        Socket m_sock;
+        PrefixTrie<handler> m_handlers;
+        // reused for every message, so a steady stream of similar messages doesn't allocate
+        Message m_msg;
+        uint64_t m_unmatched;
+
+      public:
+        /*!
+         * \brief Constructor
+         * \pre None
+         * \post the subscriber will connect to endpt; it receives nothing until a handler is registered
+         */
+        Subscriber (const std::string &endpt);
+
+        /*!
+         * \brief registers fn for messages whose first frame starts with prefix
+         * \pre None
+         * \post the socket is subscribed to prefix; a handler already registered for prefix is replaced
+         *
+         * The socket is this thread's cached SUB socket for the endpoint: register and dispatch from one thread
+         * (and not from inside a handler, which may be running out of the trie)
+         */
+        void on (const std::string &prefix, const handler &fn);
+        /*!
+         * \brief removes the handler for prefix
+         * \pre None
+         * \post the socket is unsubscribed from prefix; messages it matched go to the next-longest prefix, if any
+         * \returns false if no handler was registered for prefix
+         */
+        bool off (const std::string &prefix);
+
+        /*!
+         * \brief waits up to timeout_ms for messages and hands each one queued to its handler
+         * \pre None
+         * \post every message that was waiting has been dispatched (or counted as unmatched)
+         * \returns the number of messages handed to a handler
+         */
+        size_t dispatch (const long timeout_ms = -1);
+
+        /*!
+         * \brief the number of registered handlers
+         * \pre None
+         * \post None
+         * \returns the handler count
+         */
+        size_t handlers() const
+        {
+            return m_handlers.size();
+        }
+        /*!
+         * \brief messages that arrived with no handler to take them (e.g. still in flight after an off())
+         * \pre None
+         * \post None
+         * \returns the count
+         */
+        uint64_t unmatched() const
+        {
+            return m_unmatched;
+        }
+        /*!
+         * \brief the socket underneath
+         * \pre None
+         * \post None
+         * \returns the Socket
+         */
+        Socket &socket()
+        {
+            return m_sock;
+        }
+    };
+}
@@ -0,0 +1,337 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file shm.cpp
+ * \author Nathan Eloe
+ * \brief Implementation of the shared-memory frame ring
+ */
+
+#include "shm.h"
+#include "messages/frame.h"
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <map>
+#include <mutex>
+#include <random>
+#include <signal.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace zmqcpp
+{
+    namespace
+    {
+        const char SEG_MAGIC[8] = {'Z', 'C', 'P', 'P', 'S', 'E', 'G', '3'};
+        const char DESC_MAGIC[8] = {'Z', 'C', 'P', 'P', 'S', 'H', 'M', '3'};
+        const size_t ALIGN = 64;
+
+        // a record's tag is (generation << 2) | state, in one word so that checking the generation and
+        // changing the state is a single compare-and-swap
+        enum rec_state : uint64_t
+        {
+            BUSY = 1,      // written by the sender, not yet released by the receiver
+            RELEASED = 2,  // the receiver is done; the sender may reclaim it
+            WRAP = 3       // nothing here; the next record is at the start of the ring
+        };
+        const uint64_t STATE_MASK = 3;
+
+        uint64_t tag (const uint64_t gen, const rec_state state)
+        {
+            return (gen << 2) | state;
+        }
+
+        struct seg_hdr
+        {
+            char magic[8];
+            uint64_t cap;
+            uint64_t instance;              // different every time a segment is created
+            std::atomic<uint32_t> closed;   // set by the sender just before it unlinks the segment
+            char pad[ALIGN - 28];
+        };
+
+        struct rec_hdr
+        {
+            std::atomic<uint64_t> tag;
+            uint64_t size;       // of the whole record, header included
+            int64_t expires_ns;  // the sender's steady clock; past this, the sender may take the record back
+            char pad[ALIGN - 24];
+        };
+
+        static_assert (sizeof (seg_hdr) == ALIGN && sizeof (rec_hdr) == ALIGN, "shared memory headers must be one cache line");
+
+        size_t align_up (const size_t n)
+        {
+            return (n + ALIGN - 1) & ~ (ALIGN - 1);
+        }
+
+        std::string seg_name (const uint64_t segment)
+        {
+            return "/zmqcpp-" + std::to_string (segment >> 32) + "-" + std::to_string (segment & 0xffffffff);
+        }
+
+        std::runtime_error sys_error (const std::string &what)
+        {
+            return std::runtime_error (what + ": " + strerror (errno));
+        }
+
+        // a receiver's mapping of one segment; frames from it hold a reference, so it outlives the cache entry
+        struct mapping
+        {
+            char *base;
+            size_t size;
+            uint64_t instance;
+
+            ~mapping()
+            {
+                munmap (base, size);
+            }
+            const seg_hdr *hdr() const
+            {
+                return reinterpret_cast<const seg_hdr *> (base);
+            }
+        };
+
+        // what a received frame hangs on to until it is dropped
+        struct rec_ref
+        {
+            std::shared_ptr<mapping> seg;
+            rec_hdr *rec;
+            uint64_t gen;
+        };
+
+        std::mutex maps_lock;
+        std::map<uint64_t, std::shared_ptr<mapping>> maps;
+
+        // drops cache entries for segments that are closed or whose sender has died; needs maps_lock
+        void sweep()
+        {
+            for (auto it = maps.begin(); it != maps.end();)
+            {
+                const pid_t pid = static_cast<pid_t> (it->first >> 32);
+                if (it->second->hdr()->closed.load (std::memory_order_acquire) || (kill (pid, 0) < 0 && errno == ESRCH))
+                    it = maps.erase (it);
+                else
+                    ++it;
+            }
+        }
+
+        std::shared_ptr<mapping> mapped (const uint64_t segment, const uint64_t instance)
+        {
+            std::lock_guard<std::mutex> lock (maps_lock);
+            auto it = maps.find (segment);
+            if (it != maps.end())
+            {
+                std::shared_ptr<mapping> m = it->second;
+                if (m->instance == instance)
+                {
+                    // still good for this frame, but the segment won't be sending any more
+                    if (m->hdr()->closed.load (std::memory_order_acquire))
+                        maps.erase (it);
+                    return m;
+                }
+                // the name now belongs to a newer segment (re-created ring, or a reused pid)
+                maps.erase (it);
+            }
+            sweep();
+            const std::string name = seg_name (segment);
+            const int fd = shm_open (name.c_str(), O_RDWR, 0);
+            if (fd < 0)
+                throw sys_error ("shm_open " + name);
+            struct stat st;
+            void *base = MAP_FAILED;
+            if (fstat (fd, &st) == 0 && static_cast<size_t> (st.st_size) >= sizeof (seg_hdr))
+                base = mmap (nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            close (fd);
+            if (base == MAP_FAILED)
+                throw sys_error ("mmap " + name);
+            std::shared_ptr<mapping> m (new mapping {static_cast<char *> (base), static_cast<size_t> (st.st_size), 0});
+            if (memcmp (m->hdr()->magic, SEG_MAGIC, sizeof (SEG_MAGIC)))
+                throw std::runtime_error ("not a shared memory ring: " + name);
+            m->instance = m->hdr()->instance;
+            if (m->instance != instance)
+                throw std::runtime_error ("stale shared memory descriptor: " + name + " has been re-created");
+            if (!m->hdr()->closed.load (std::memory_order_acquire))
+                maps[segment] = m;
+            return m;
+        }
+
+        void release_rec (void *base, size_t len, void *hint)
+        {
+            rec_ref *ref = static_cast<rec_ref *> (hint);
+            // only if the record is still the one this frame came from (the sender may have expired and reused it)
+            uint64_t busy = tag (ref->gen, BUSY);
+            ref->rec->tag.compare_exchange_strong (busy, tag (ref->gen, RELEASED), std::memory_order_release);
+            delete ref;
+        }
+
+        int64_t now_ns()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        uint64_t new_instance()
+        {
+            std::random_device rd;
+            return (static_cast<uint64_t> (rd()) << 32 | rd()) ^ std::chrono::steady_clock::now().time_since_epoch().count();
+        }
+    }
+
+    ShmRing::ShmRing (const size_t capacity, const std::chrono::milliseconds lease):
+        m_base (nullptr), m_cap (align_up (capacity)), m_gen (0),
+        m_lease_ns (std::chrono::duration_cast<std::chrono::nanoseconds> (lease).count()), m_head (0), m_tail (0), m_used (0), m_expired (0)
+    {
+        static std::atomic<uint32_t> rings (0);
+        m_segment = (static_cast<uint64_t> (getpid()) << 32) | rings++;
+        m_name = seg_name (m_segment);
+        const int fd = shm_open (m_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd < 0)
+            throw sys_error ("shm_open " + m_name);
+        void *base = MAP_FAILED;
+        if (ftruncate (fd, sizeof (seg_hdr) + m_cap) == 0)
+            base = mmap (nullptr, sizeof (seg_hdr) + m_cap, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close (fd);
+        if (base == MAP_FAILED)
+        {
+            shm_unlink (m_name.c_str());
+            throw sys_error ("mmap " + m_name);
+        }
+        m_base = static_cast<char *> (base);
+        seg_hdr *hdr = reinterpret_cast<seg_hdr *> (m_base);
+        memcpy (hdr->magic, SEG_MAGIC, sizeof (SEG_MAGIC));
+        hdr->cap = m_cap;
+        hdr->instance = m_instance = new_instance();
+        hdr->closed.store (0, std::memory_order_release);
+    }
+
+    ShmRing::~ShmRing()
+    {
+        reinterpret_cast<seg_hdr *> (m_base)->closed.store (1, std::memory_order_release);
+        munmap (m_base, sizeof (seg_hdr) + m_cap);
+        shm_unlink (m_name.c_str());
+    }
+
+    void ShmRing::reclaim()
+    {
+        char *data = m_base + sizeof (seg_hdr);
+        while (m_used)
+        {
+            rec_hdr *r = reinterpret_cast<rec_hdr *> (data + m_tail);
+            uint64_t t = r->tag.load (std::memory_order_acquire);
+            // a record nobody released within its lease (dropped descriptor, departed peer) is taken back,
+            // so it can't hold up the ring for good; the swap fails if the receiver released it meanwhile
+            if ((t & STATE_MASK) == BUSY && now_ns() >= r->expires_ns
+                    && r->tag.compare_exchange_strong (t, (t & ~STATE_MASK) | RELEASED, std::memory_order_acq_rel))
+            {
+                t = (t & ~STATE_MASK) | RELEASED;
+                m_expired++;
+            }
+            size_t len;
+            if ((t & STATE_MASK) == WRAP)
+                len = m_cap - m_tail;
+            else if ((t & STATE_MASK) == RELEASED)
+                len = r->size;
+            else
+                break;
+            m_used -= len;
+            m_tail = (m_tail + len) % m_cap;
+        }
+        if (!m_used)
+            m_head = m_tail = 0;
+    }
+
+    bool ShmRing::put (const void *data, const size_t size, shm_desc &desc)
+    {
+        const size_t need = sizeof (rec_hdr) + align_up (size);
+        if (need > m_cap)
+            return false;
+        reclaim();
+        char *area = m_base + sizeof (seg_hdr);
+        if (m_used && m_head <= m_tail)
+        {
+            // the free space is the gap between head and tail
+            if (need > m_tail - m_head)
+                return false;
+        }
+        else if (need > m_cap - m_head)
+        {
+            // not enough room before the end; start over at the front if the tail has moved far enough
+            if (need > m_tail)
+                return false;
+            reinterpret_cast<rec_hdr *> (area + m_head)->tag.store (tag (0, WRAP), std::memory_order_relaxed);
+            m_used += m_cap - m_head;
+            m_head = 0;
+        }
+        rec_hdr *r = reinterpret_cast<rec_hdr *> (area + m_head);
+        const uint64_t gen = ++m_gen;
+        r->size = need;
+        r->expires_ns = now_ns() + m_lease_ns;
+        memcpy (reinterpret_cast<char *> (r) + sizeof (rec_hdr), data, size);
+        r->tag.store (tag (gen, BUSY), std::memory_order_release);
+        memcpy (desc.magic, DESC_MAGIC, sizeof (DESC_MAGIC));
+        desc.segment = m_segment;
+        desc.offset = sizeof (seg_hdr) + m_head + sizeof (rec_hdr);
+        desc.length = size;
+        desc.gen = gen;
+        desc.instance = m_instance;
+        m_used += need;
+        m_head = (m_head + need) % m_cap;
+        return true;
+    }
+
+    void ShmRing::unput (const shm_desc &desc)
+    {
+        rec_hdr *r = reinterpret_cast<rec_hdr *> (m_base + desc.offset) - 1;
+        r->tag.store (tag (desc.gen, RELEASED), std::memory_order_release);
+    }
+
+    bool ShmRing::is_desc (const void *data, const size_t size)
+    {
+        return size == sizeof (shm_desc) && !memcmp (data, DESC_MAGIC, sizeof (DESC_MAGIC));
+    }
+
+    std::shared_ptr<std::string> ShmRing::open (const void *data)
+    {
+        shm_desc d;
+        memcpy (&d, data, sizeof (d));
+        std::shared_ptr<mapping> seg = mapped (d.segment, d.instance);
+        if (d.offset < sizeof (seg_hdr) + sizeof (rec_hdr) || d.length > seg->size || d.offset > seg->size - d.length)
+            throw std::runtime_error ("shared memory descriptor out of range");
+        rec_hdr *r = reinterpret_cast<rec_hdr *> (seg->base + d.offset) - 1;
+        if (r->tag.load (std::memory_order_acquire) != tag (d.gen, BUSY))
+            throw std::runtime_error ("stale shared memory descriptor");
+        extern_frame x = {seg->base + d.offset, static_cast<size_t> (d.length), nullptr, 0, new rec_ref {seg, r, d.gen}, release_rec};
+        return std::shared_ptr<std::string> (new std::string(), x);
+    }
+
+    std::shared_ptr<std::string> ShmRing::try_open (const void *data)
+    {
+        try
+        {
+            return open (data);
+        }
+        catch (const std::runtime_error &)
+        {
+            return nullptr;
+        }
+    }
+}
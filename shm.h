@@ -0,0 +1,140 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file shm.h
+ * \author Nathan Eloe
+ * \brief A shared-memory ring for passing large frames between processes on the same host
+ *
+ * The sender copies a frame into its ring and sends a small descriptor frame in its place.  The
+ * receiver maps the ring and exposes the record as an extern frame; dropping that frame marks the
+ * record released in the shared header, which is how the sender learns it can reuse the space.
+ *
+ * Each record is leased to its receiver: one not released within the lease (its descriptor was dropped,
+ * or the peer went away) is taken back by the sender, and its descriptor goes stale.  A receiver has to
+ * be done with a frame within the lease, or it may see the space reused under it.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace zmqcpp
+{
+    /*!
+     * \brief What travels through the socket in place of a frame that went through shared memory
+     */
+    struct shm_desc
+    {
+        char magic[8];
+        uint64_t segment;  // (pid << 32) | ring number, which names the segment
+        uint64_t offset;   // of the payload from the start of the segment
+        uint64_t length;
+        uint64_t gen;      // must match the record's generation, or the descriptor is stale
+        uint64_t instance; // must match the segment's, or the segment has been re-created since
+    };
+
+    class ShmRing
+    {
+      private:
+        std::string m_name;
+        char *m_base;
+        size_t m_cap;     // bytes in the data area
+        uint64_t m_segment;
+        uint64_t m_instance;
+        uint64_t m_gen;
+        int64_t m_lease_ns;
+        // the ring is single-producer, so these live only in the sender
+        size_t m_head, m_tail, m_used;
+        uint64_t m_expired;
+
+        void reclaim();
+
+      public:
+        /*!
+         * \brief Constructor
+         * \pre None
+         * \post a new shared memory segment with a data area of (at least) capacity bytes exists; records
+         *       not released within lease are taken back
+         * \throws std::runtime_error if the segment can't be created or mapped
+         */
+        ShmRing (const size_t capacity, const std::chrono::milliseconds lease = std::chrono::milliseconds (5000));
+        /*!
+         * \brief Destructor
+         * \pre None
+         * \post the segment is marked closed and unlinked; receivers unmap it once they drop their last frame from it
+         */
+        ~ShmRing();
+        ShmRing (const ShmRing &) = delete;
+        ShmRing &operator= (const ShmRing &) = delete;
+
+        /*!
+         * \brief copies a frame into the ring
+         * \pre None
+         * \post on success, desc describes the copy, which stays put until the receiver releases it
+         * \returns false if the ring has no room (the frame should go through the socket instead)
+         */
+        bool put (const void *data, const size_t size, shm_desc &desc);
+        /*!
+         * \brief gives back a record whose descriptor was never sent
+         * \pre desc came from this ring's put() and no receiver has it
+         * \post the record's space can be reused
+         */
+        void unput (const shm_desc &desc);
+
+        /*!
+         * \brief checks whether a received frame is a shared memory descriptor
+         * \pre None
+         * \post None
+         * \returns true if the frame has a descriptor's size and magic
+         */
+        static bool is_desc (const void *data, const size_t size);
+        /*!
+         * \brief the number of records taken back because their lease ran out
+         * \pre None
+         * \post None
+         * \returns the count
+         */
+        uint64_t expired() const
+        {
+            return m_expired;
+        }
+        /*!
+         * \brief maps the record a descriptor points to
+         *
+         * Mappings are cached per segment and checked against the descriptor's instance, so a segment
+         * re-created under the same name (or a reused pid) is mapped afresh.  A mapping is dropped from the
+         * cache once its segment is closed or its owner has died, and unmapped when its last frame goes.
+         * \pre is_desc (data, size)
+         * \post None
+         * \returns an extern frame over the record; dropping its last reference releases the record
+         * \throws std::runtime_error if the segment is gone or the descriptor is stale
+         */
+        static std::shared_ptr<std::string> open (const void *data);
+        /*!
+         * \brief like open(), for the receive path, where an exception would leave a message half read
+         * \pre is_desc (data, size)
+         * \post None
+         * \returns the frame, or nullptr if the segment is gone or the descriptor is stale or out of range
+         */
+        static std::shared_ptr<std::string> try_open (const void *data);
+    };
+}
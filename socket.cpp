@@ -24,6 +24,8 @@
 #include "socket.h"
 #include "context.h"
 #include "messages/message.h"
+#include <algorithm>
+#include <cstring>
 #include <functional>
 #include <iostream>
 
@@ -32,44 +34,82 @@ namespace zmqcpp
     std::shared_ptr<zmq::context_t> Context::m_ctx = nullptr;
     thread_local std::map<size_t, std::shared_ptr<zmq::socket_t>> Socket::m_conn;
     std::map<size_t, std::shared_ptr<zmq::socket_t>> Socket::m_bind;
-    std::map<void *, std::shared_ptr<std::string>> Socket::m_unsent;
+    Socket::pin *Socket::m_pins = nullptr;
+    std::mutex Socket::m_pin_lock;
     std::map<std::string, std::map<int, sockopt>> Socket::m_optcache;
 
     void Socket::_conn()
     {
-        static bool run = true;
-        if (run)
+        // the connection cache is thread_local, so a cached socket is only good on the thread that looked it up
+        if (m_sock_from == CONN && m_sock_thread == std::this_thread::get_id())
+            return;
+        m_conn_hash = hash_list (m_conn_endpts);
+        if (!m_conn.count (m_conn_hash))
         {
-            m_conn_hash = hash_list (m_conn_endpts);
-            if (!m_conn.count (m_conn_hash))
-            {
-                m_conn[m_conn_hash] = std::make_shared<zmq::socket_t> (zmq::socket_t (Context::get(), m_type));
-                for (auto opt : m_sockopts)
-                    m_conn[m_conn_hash] -> setsockopt (opt.first, opt.second.val.get(), opt.second.vsize);
-                for (const std::string &e : m_conn_endpts)
-                    m_conn[m_conn_hash]->connect (e.c_str());
-            }
-            m_sock = m_conn[m_conn_hash];
+            m_conn[m_conn_hash] = std::make_shared<zmq::socket_t> (zmq::socket_t (Context::get(), m_type));
+            for (auto opt : m_sockopts)
+                m_conn[m_conn_hash] -> setsockopt (opt.first, opt.second.val.get(), opt.second.vsize);
+            for (const std::string &e : m_conn_endpts)
+                m_conn[m_conn_hash]->connect (e.c_str());
         }
+        m_sock = m_conn[m_conn_hash];
+        m_sock_from = CONN;
+        m_sock_thread = std::this_thread::get_id();
         return;
     }
     void Socket::_bind()
     {
-        static bool run = true;
-        if (run)
+        if (m_sock_from == BIND)
+            return;
+        m_bind_hash = hash_list (m_bind_endpts);
+        if (!m_bind.count (m_bind_hash))
+        {
+            m_bind[m_bind_hash] = std::make_shared<zmq::socket_t> (zmq::socket_t (Context::get(), m_type));
+            for (auto opt : m_sockopts)
+                m_bind[m_bind_hash] -> setsockopt (opt.first, opt.second.val.get(), opt.second.vsize);
+            for (const std::string &e : m_bind_endpts)
+                m_bind[m_bind_hash]->bind (e.c_str());
+        }
+        m_sock = m_bind[m_bind_hash];
+        m_sock_from = BIND;
+        return;
+    }
+
+    Socket::pin *Socket::pin_frame (const std::shared_ptr<std::string> &frame)
+    {
+        pin *p = nullptr;
         {
-            m_bind_hash = hash_list (m_bind_endpts);
-            if (!m_bind.count (m_bind_hash))
+            std::lock_guard<std::mutex> lock (m_pin_lock);
+            if (m_pins)
             {
-                m_bind[m_bind_hash] = std::make_shared<zmq::socket_t> (zmq::socket_t (Context::get(), m_type));
-                for (auto opt : m_sockopts)
-                    m_bind[m_bind_hash] -> setsockopt (opt.first, opt.second.val.get(), opt.second.vsize);
-                for (const std::string &e : m_bind_endpts)
-                    m_bind[m_bind_hash]->bind (e.c_str());
+                p = m_pins;
+                m_pins = p->next;
             }
-            m_sock = m_bind[m_bind_hash];
         }
-        return;
+        if (!p)
+            p = new pin;
+        p->frame = frame;
+        return p;
+    }
+
+    void Socket::strp_free (void *ptr, void *hint)
+    {
+        pin *p = static_cast<pin *> (hint);
+        p->frame = nullptr;
+        std::lock_guard<std::mutex> lock (m_pin_lock);
+        p->next = m_pins;
+        m_pins = p;
+    }
+
+    namespace
+    {
+        std::list<std::shared_ptr<std::string>> copy_frames (const const_buffer *bufs, const size_t count)
+        {
+            std::list<std::shared_ptr<std::string>> frames;
+            for (size_t i = 0; i < count; i++)
+                frames.push_back (std::make_shared<std::string> (static_cast<const char *> (bufs[i].data), bufs[i].size));
+            return frames;
+        }
     }
 
     size_t Socket::hash_list (std::vector<std::string> &strvec)
@@ -81,6 +121,173 @@ namespace zmqcpp
         return std::hash<std::string>() (ss.str());
     }
 
+    bool Socket::send_frames (const std::list<std::shared_ptr<std::string>> &frames, const int opts)
+    {
+        zmq::message_t z_msg;
+        shm_desc desc;
+        size_t count = 1;
+        for (const auto &s : frames)
+        {
+            bool in_shm = false;
+            // extern frames are always sent in place; the pin keeps their region alive
+            if (const extern_frame *x = std::get_deleter<extern_frame> (s))
+                z_msg.rebuild ((void *)x->data, x->size, strp_free, pin_frame (s));
+            // same-host peer: one copy into shared memory and a descriptor through the socket
+            else if (m_shm_threshold && s->size() >= m_shm_threshold && shm_put (s->data(), s->size(), desc))
+            {
+                in_shm = true;
+                z_msg.rebuild (sizeof (desc));
+                memcpy (z_msg.data(), &desc, sizeof (desc));
+            }
+            // small frames are cheaper to copy inline than to pin; with a pool everything is copied
+            else if (m_pool || s->size() <= INLINE_FRAME)
+            {
+                if (s->size() > INLINE_FRAME)
+                    m_pool->build (z_msg, s->size());
+                else
+                    z_msg.rebuild (s->size());
+                memcpy (z_msg.data(), s->data(), s->size());
+            }
+            else
+                z_msg.rebuild ((void *)s->c_str(), s->size(), strp_free, pin_frame (s));
+            // libzmq only turns a message away at its first frame (the rest of a message never hits the
+            // high water mark), so stopping here means none of the message was queued
+            if (!raw_sock().send (z_msg, (count < frames.size()) ? (opts | ZMQ_SNDMORE) : opts))
+            {
+                if (in_shm)
+                    m_shm->unput (desc);
+                m_stats.would_block++;
+                return false;
+            }
+            count ++;
+        }
+        m_stats.sent++;
+        return true;
+    }
+
+    bool Socket::park (std::list<std::shared_ptr<std::string>> frames)
+    {
+        if (m_outbox.size() >= m_outbox_max)
+        {
+            m_stats.rejected++;
+            if (m_on_full)
+                m_on_full (m_outbox.size());
+            return false;
+        }
+        m_outbox.push_back (std::move (frames));
+        m_stats.queued++;
+        m_stats.outbox_peak = std::max (m_stats.outbox_peak, m_outbox.size());
+        return true;
+    }
+
+    size_t Socket::flush()
+    {
+        if (m_outbox.empty())
+            return 0;
+        if (m_conn_endpts.size()) _conn();
+        else _bind();
+        while (!m_outbox.empty() && send_frames (m_outbox.front(), ZMQ_DONTWAIT))
+            m_outbox.pop_front();
+        return m_outbox.size();
+    }
+
+    bool Socket::writable()
+    {
+        if (m_conn_endpts.size()) _conn();
+        else _bind();
+        int events;
+        size_t esize = sizeof (events);
+        raw_sock().getsockopt (ZMQ_EVENTS, &events, &esize);
+        return events & ZMQ_POLLOUT;
+    }
+
+    bool Socket::sendv (const const_buffer *bufs, const size_t count, const int opts)
+    {
+        if (!count)
+            return false;
+        if (m_conn_endpts.size()) _conn();
+        else _bind();
+        // queued messages go first; a new one may not overtake them
+        bool win = m_outbox.empty() || !flush();
+        {
+            zmq::message_t z_msg;
+            for (size_t i = 0; i < count && win; i++)
+            {
+                if (m_pool && bufs[i].size > INLINE_FRAME)
+                    m_pool->build (z_msg, bufs[i].size);
+                else
+                    z_msg.rebuild (bufs[i].size);
+                memcpy (z_msg.data(), bufs[i].data, bufs[i].size);
+                // as in send_frames(), only the first frame can be turned away
+                if (! (win = raw_sock().send (z_msg, (i + 1 < count) ? (opts | ZMQ_SNDMORE) : opts)))
+                    m_stats.would_block++;
+            }
+        }
+        if (win)
+            m_stats.sent++;
+        else if (m_outbox_max)
+            win = park (copy_frames (bufs, count));
+        if (m_cap && win)
+            m_cap->record (m_cap_id, OUTBOUND, bufs, count);
+        return win;
+    }
+
+    bool Socket::sendv (const const_buffer *bufs, const size_t count, buf_free_fn *release, void *hint, const int opts)
+    {
+        if (!count)
+            return false;
+        if (m_conn_endpts.size()) _conn();
+        else _bind();
+        size_t i = 0;
+        // queued messages go first; a new one may not overtake them
+        bool win = m_outbox.empty() || !flush();
+        // libzmq may let go of a borrowed buffer as soon as its frame is queued, so a capture (logged only once
+        // the message is sent or parked, like the copying sendv()) and the outbox work from a copy taken now
+        std::list<std::shared_ptr<std::string>> copy;
+        if (m_cap && win)
+            copy = copy_frames (bufs, count);
+        {
+            zmq::message_t z_msg;
+            for (; i < count && win; i++)
+            {
+                // once rebuilt, the message owns the release of this buffer whether or not it gets sent
+                z_msg.rebuild (const_cast<void *> (bufs[i].data), bufs[i].size, release, hint);
+                if (! (win = raw_sock().send (z_msg, (i + 1 < count) ? (opts | ZMQ_SNDMORE) : opts)))
+                    m_stats.would_block++;
+            }
+            // the outbox needs its own copy, taken before z_msg lets go of the buffer it holds
+            if (!win && m_outbox_max && copy.empty())
+                copy = copy_frames (bufs, count);
+        }
+        for (; i < count; i++)
+            release (const_cast<void *> (bufs[i].data), hint);
+        if (win)
+            m_stats.sent++;
+        else if (m_outbox_max)
+            win = park (copy);
+        if (m_cap && win)
+        {
+            std::vector<const_buffer> frames;
+            for (const std::shared_ptr<std::string> &f : copy)
+                frames.push_back (const_buffer {f->data(), f->size()});
+            m_cap->record (m_cap_id, OUTBOUND, frames.data(), frames.size());
+        }
+        return win;
+    }
+
+    bool Socket::shm_put (const void *data, const size_t size, shm_desc &desc)
+    {
+        if (!m_shm)
+        {
+            const std::vector<std::string> &endpts = m_conn_endpts.size() ? m_conn_endpts : m_bind_endpts;
+            for (const std::string &e : endpts)
+                if (e.compare (0, 6, "ipc://") && e.compare (0, 9, "inproc://"))
+                    return false;
+            m_shm = std::make_shared<ShmRing> (m_shm_size, m_shm_lease);
+        }
+        return m_shm->put (data, size, desc);
+    }
+
     zmq::socket_t &Socket::raw_sock()
     {
         if (!m_sock)
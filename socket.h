@@ -23,12 +23,24 @@
 
 #pragma once
 
+#include <chrono>
+#include <deque>
 #include <exception>
+#include <functional>
+#include <list>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <sstream>
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <vector>
 #include <zmq.hpp>
+#include "buffer_pool.h"
+#include "capture.h"
+#include "shm.h"
+#include "messages/frame.h"
 #include "messages/_base_msg.h"
 
 namespace zmqcpp
@@ -48,6 +60,38 @@ namespace zmqcpp
         size_t vsize;
     };
 
+    // libzmq keeps frames up to this size inside the zmq_msg_t itself, so copying them never allocates
+    const size_t INLINE_FRAME = 29;
+
+    /*!
+     * \brief What a recv_frames() callback wants done after seeing a frame
+     */
+    enum frame_act
+    {
+        FRAME_NEXT,  // hand over the next frame
+        FRAME_STOP,  // return now; the rest of the message stays queued for the next recv
+        FRAME_SKIP   // return now, discarding the rest of the message
+    };
+
+    /*!
+     * \brief Called once libzmq is done with a borrowed buffer (same signature as zmq_free_fn)
+     */
+    typedef void (buf_free_fn) (void *data, void *hint);
+
+    template <int Type, class Mode, class Parts> class TypedSocket;
+
+    /*!
+     * \brief Counters kept by every Socket (see Socket::stats())
+     */
+    struct socket_stats
+    {
+        uint64_t sent;         // messages libzmq accepted
+        uint64_t would_block;  // times libzmq turned a message away because the socket was full
+        uint64_t queued;       // messages parked in the outbox
+        uint64_t rejected;     // messages refused because the outbox was full
+        size_t outbox_peak;    // the deepest the outbox has been
+    };
+
     class Socket
     {
       private:
@@ -69,18 +113,106 @@ namespace zmqcpp
         // Type of the socket
         int m_type;
         std::string curr_endpt;
+        // where copied frames get their memory (nullptr: libzmq mallocs them)
+        BufferPool *m_pool;
+        // frames of at least m_shm_threshold bytes go through shared memory (0: off)
+        size_t m_shm_threshold, m_shm_size;
+        std::chrono::milliseconds m_shm_lease;
+        std::shared_ptr<ShmRing> m_shm;
+        // where traffic is teed to (nullptr: off), and the id stamped on this socket's records
+        Capture *m_cap;
+        uint32_t m_cap_id;
+        // messages libzmq couldn't take yet, oldest first (see set_outbox())
+        std::deque<std::list<std::shared_ptr<std::string>>> m_outbox;
+        size_t m_outbox_max;
+        std::function<void (size_t)> m_on_full;
+        socket_stats m_stats;
 
-        static std::map<void *, std::shared_ptr<std::string>> m_unsent;
+        /*!
+         * \brief hands one message to libzmq, stopping at the first frame it refuses
+         * \pre the socket exists (_conn() or _bind() has been called)
+         * \post on success, the whole message is queued in libzmq; on failure none of it is
+         * \returns false if libzmq would have blocked
+         */
+        bool send_frames (const std::list<std::shared_ptr<std::string>> &frames, const int opts);
+        /*!
+         * \brief puts a message libzmq turned away at the back of the outbox
+         * \pre the outbox is on
+         * \post the message is queued, or the full-outbox callback has been told it was refused
+         * \returns false if the outbox is full
+         */
+        bool park (std::list<std::shared_ptr<std::string>> frames);
 
         /*!
-         * \brief the "zero-copy" deleter; the smart pointers will deal with that for us
+         * \brief copies a frame into this socket's shared memory ring
          * \pre None
-         * \post None
+         * \post on success, desc describes the copy; the ring is created on first use
+         * \returns false if every endpoint isn't local (ipc:// or inproc://) or the ring is full
          */
-        static void strp_free (void *ptr, void *_)
+        bool shm_put (const void *data, const size_t size, shm_desc &desc);
+
+        // which cache m_sock came from, so _conn()/_bind() can skip the lookup on every send/recv
+        enum {NONE, CONN, BIND} m_sock_from;
+        std::thread::id m_sock_thread;
+
+        // keeps a frame alive while libzmq owns it; recycled through a free list so sends don't allocate
+        struct pin
         {
-            m_unsent.erase (ptr);
-        }
+            std::shared_ptr<std::string> frame;
+            pin *next;
+        };
+        static pin *m_pins;
+        static std::mutex m_pin_lock;
+
+        /*!
+         * \brief takes a pin off the free list (or makes one if the list is empty)
+         * \pre None
+         * \post the pin holds frame
+         * \returns the pin, to be used as the zmq free function's hint
+         */
+        static pin *pin_frame (const std::shared_ptr<std::string> &frame);
+
+        /*!
+         * \brief the "zero-copy" deleter; drops the pinned frame and recycles the pin
+         * \pre hint is a pin from pin_frame()
+         * \post None
+         */
+        static void strp_free (void *ptr, void *hint);
+
+        ///@{
+        /*!
+         * \brief the bodies of send(), recv(), recv_into() and recv_frames()
+         * \pre the socket exists (_conn() or _bind() has been called)
+         * \post as for the public functions; with Multi false, only one frame is read and ZMQ_RCVMORE is never checked
+         *
+         * TypedSocket calls these directly, having picked connect or bind at compile time
+         */
+        template <class T>
+        bool do_send (const BaseMessage<T> &msg, const int opts);
+        template <bool Multi, class T>
+        bool do_recv (BaseMessage<T> &msg, const int opts);
+        template <bool Multi, class T>
+        bool do_recv_into (BaseMessage<T> &msg, const int opts);
+        template <bool Multi, class F>
+        bool do_recv_frames (F fn, const int opts);
+        ///@}
+        /*!
+         * \brief sends the message's routing frames (see BaseMessage::hop()) ahead of its body
+         * \pre the socket exists
+         * \post each hop is zmq_msg_copy'd into the socket; last means the body is empty
+         * \returns false if libzmq turned the first hop away (nothing was queued)
+         */
+        template <class T>
+        bool send_hops (const T &msg, const bool last, const int opts);
+        /*!
+         * \brief the message as one frame list, routing frames copied in ahead of the body (for the outbox)
+         * \pre None
+         * \post None
+         * \returns the frames
+         */
+        template <class T>
+        static std::list<std::shared_ptr<std::string>> with_hops (const T &msg, const std::list<std::shared_ptr<std::string>> &frames);
+        template <int Type, class Mode, class Parts> friend class TypedSocket;
 
       public:
         size_t hash_list (std::vector<std::string> &strvec);
@@ -104,7 +236,8 @@ namespace zmqcpp
          * \pre None
          * \post The socket is constructed with the specified socket type
          */
-        Socket (const int type): m_sock (nullptr), m_type (type) {}
+        Socket (const int type): m_sock (nullptr), m_type (type), m_pool (nullptr), m_shm_threshold (0), m_shm_size (0), m_shm_lease (0), m_cap (nullptr), m_cap_id (0),
+            m_outbox_max (0), m_stats (), m_sock_from (NONE) {}
         /*!
          * \brief Destructor
          * \pre None
@@ -127,6 +260,7 @@ namespace zmqcpp
          */
         void connect (const std::string &endpt)
         {
+            m_sock_from = NONE;
             m_conn_endpts.push_back (endpt);
             curr_endpt = endpt;
         }
@@ -148,6 +282,7 @@ namespace zmqcpp
          */
         void bind (const std::string &endpt)
         {
+            m_sock_from = NONE;
             m_bind_endpts.push_back (endpt);
             curr_endpt = endpt;
         }
@@ -163,7 +298,9 @@ namespace zmqcpp
          * \pre type T has the prep_frames() and unprep_frames() functions implemented
          * \post the message (possibly multi-part) is sent over the wire
          * \post for multi-part messages, ZMQ_SNDMORE is forced for all but the last frame
-         * \returns Whether the send was successful or not (as per the ZMQ C++ api)
+         * \post the message is queued whole or not at all, so a ZMQ_DONTWAIT send never leaves half a message behind
+         * \post with the outbox on, a message libzmq can't take yet (or that would overtake queued ones) waits in the outbox
+         * \returns Whether the message was sent or queued
          */
         template <class T>
         bool send (const BaseMessage<T> &msg, const int opts = 0);
@@ -178,6 +315,63 @@ namespace zmqcpp
         template <class T>
         bool recv (BaseMessage<T> &msg, const int opts = 0);
 
+        /*!
+         * \brief recv's the message over the socket, replacing msg's frames instead of appending to them
+         * \pre The type of this socket must be allowed to recv (e.g. no ZMQ_PUSH)
+         * \pre type T has the start_recv() function implemented
+         * \post msg holds exactly the frames of the received message
+         * \post msg's previous frame slots and string capacity are reused, so a receive loop stops
+         *       allocating once it has seen its largest message
+         * \returns Whether the recv was successful or not (as per the ZMQ C++ api)
+         */
+        template <class T>
+        bool recv_into (BaseMessage<T> &msg, const int opts = 0);
+
+        /*!
+         * \brief recv's a message one frame at a time, handing each to fn as it is dequeued
+         * \pre The type of this socket must be allowed to recv (e.g. no ZMQ_PUSH)
+         * \pre fn is callable as frame_act fn (const const_buffer &frame, bool more)
+         * \post fn has seen every frame up to the one it answered FRAME_STOP or FRAME_SKIP to
+         * \post the frame view is only valid during the call; nothing is copied
+         * \returns Whether the recv was successful or not (as per the ZMQ C++ api)
+         */
+        template <class F>
+        bool recv_frames (F fn, const int opts = 0);
+
+        ///@{
+        /*!
+         * \brief sends a multipart message straight from caller-owned buffers, copying each one into its frame
+         * \pre The type of this socket must be allowed to send
+         * \pre count > 0
+         * \post the buffers are sent as one (possibly multi-part) message; the caller may reuse them immediately
+         * \post the message is queued whole or not at all; with the outbox on, a refused message is copied into it
+         * \returns Whether the message was sent or queued
+         */
+        bool sendv (const const_buffer *bufs, const size_t count, const int opts = 0);
+        bool sendv (const std::vector<const_buffer> &bufs, const int opts = 0)
+        {
+            return sendv (bufs.data(), bufs.size(), opts);
+        }
+        ///@}
+
+        ///@{
+        /*!
+         * \brief sends a multipart message that borrows the caller's buffers (zero-copy)
+         * \pre The type of this socket must be allowed to send
+         * \pre count > 0
+         * \pre every buffer stays valid and unmodified until release is called for it
+         * \post release (data, hint) is called exactly once per buffer when libzmq lets go of it,
+         *       possibly from a libzmq I/O thread; buffers that were never sent are released before returning
+         * \post the message is queued whole or not at all; with the outbox on, a refused message is copied into it
+         * \returns Whether the message was sent or queued
+         */
+        bool sendv (const const_buffer *bufs, const size_t count, buf_free_fn *release, void *hint, const int opts = 0);
+        bool sendv (const std::vector<const_buffer> &bufs, buf_free_fn *release, void *hint, const int opts = 0)
+        {
+            return sendv (bufs.data(), bufs.size(), release, hint, opts);
+        }
+        ///@}
+
         /*!
          * \brief returns the raw socket
          * \pre None
@@ -243,6 +437,97 @@ namespace zmqcpp
         void disconnect()
         {
             m_conn.erase (m_conn_hash);
+            m_sock_from = NONE;
+        }
+        /*!
+         * \brief makes sends copy frames into blocks from pool instead of malloc'd or map-tracked memory
+         * \pre pool outlives every message sent through this socket (nullptr turns pooling off)
+         * \post frames larger than INLINE_FRAME are copied into pooled blocks by send() and the copying sendv()
+         */
+        void use_pool (BufferPool *pool)
+        {
+            m_pool = pool;
+        }
+        /*!
+         * \brief passes large frames through a shared memory ring when every endpoint is on this host
+         * \pre both ends of the connection call use_shm() (the receiver needs it to recognize descriptors)
+         * \pre receivers are done with each frame within lease
+         * \post send() copies frames of at least threshold bytes into a ring_size-byte ring and sends a
+         *       small descriptor instead, as long as all endpoints are ipc:// or inproc:// and the ring has room
+         * \post a record its receiver never releases (the message was dropped, the peer left, or it was read
+         *       through recv_frames()) is taken back after lease, so it can't block the ring for good
+         * \post recv()/recv_into() turn descriptors back into zero-copy frames (see frame_view())
+         * \throws std::runtime_error unless the socket is point-to-point (PAIR, PUSH, PULL, DEALER, REQ or REP):
+         *         with several receivers of one record, the first release would let the sender reuse it
+         */
+        void use_shm (const size_t threshold = 64 * 1024, const size_t ring_size = 64 * 1024 * 1024,
+                      const std::chrono::milliseconds lease = std::chrono::milliseconds (5000))
+        {
+            if (m_type != ZMQ_PAIR && m_type != ZMQ_PUSH && m_type != ZMQ_PULL && m_type != ZMQ_DEALER
+                    && m_type != ZMQ_REQ && m_type != ZMQ_REP)
+                throw std::runtime_error ("shared memory frames need a point-to-point socket type");
+            m_shm_threshold = threshold;
+            m_shm_size = ring_size;
+            m_shm_lease = lease;
+        }
+        /*!
+         * \brief tees every message this socket sends or receives into a capture log
+         * \pre cap outlives this socket's traffic (nullptr turns capture off)
+         * \post send(), sendv(), recv() and recv_into() append each whole message to cap, tagged with id;
+         *       recv_frames() and raw_sock() traffic is not captured
+         * \post only messages that were sent or parked in the outbox are logged; borrowed-buffer sendv()
+         *       copies the frames while capturing, since the buffers may be released once queued
+         */
+        void capture (Capture *cap, const uint32_t id = 0)
+        {
+            m_cap = cap;
+            m_cap_id = id;
+        }
+        /*!
+         * \brief keeps messages libzmq turns away (EAGAIN) in a bounded outbox instead of failing the send
+         * \pre None
+         * \post up to max_msgs messages wait in the outbox until flush() gets them out (0 turns the outbox off;
+         *       anything still queued goes out on the next flush())
+         * \post on_full (depth) is called whenever a message is refused because the outbox is full
+         */
+        void set_outbox (const size_t max_msgs, std::function<void (size_t)> on_full = nullptr)
+        {
+            m_outbox_max = max_msgs;
+            m_on_full = on_full;
+        }
+        /*!
+         * \brief sends queued messages until libzmq stops taking them
+         * \pre None
+         * \post the outbox holds whatever libzmq couldn't take yet; never blocks
+         * \returns the number of messages still queued
+         */
+        size_t flush();
+        /*!
+         * \brief the number of messages waiting in the outbox
+         * \pre None
+         * \post None
+         * \returns the outbox depth
+         */
+        size_t outbox_depth() const
+        {
+            return m_outbox.size();
+        }
+        /*!
+         * \brief checks whether libzmq would take a message right now (ZMQ_EVENTS has ZMQ_POLLOUT)
+         * \pre None
+         * \post the socket is created if it didn't exist yet
+         * \returns true if a send wouldn't block
+         */
+        bool writable();
+        /*!
+         * \brief this socket's counters
+         * \pre None
+         * \post None
+         * \returns the counters
+         */
+        const socket_stats &stats() const
+        {
+            return m_stats;
         }
         /* socket options */
         /*!
@@ -264,26 +549,54 @@ namespace zmqcpp
     {
         if (m_conn_endpts.size()) _conn();
         else _bind();
-        int count = 1;
-        bool win = true;
-        static zmq::message_t z_msg; //So we don't reinitialize every time, that's just silly
-        std::list<std::shared_ptr<std::string>> frames = msg.prep_frames();
-        for (auto s : frames)
+        return do_send (msg, opts);
+    }
+
+    template <class T>
+    bool Socket::do_send (const BaseMessage<T> &msg, const int opts)
+    {
+        const std::list<std::shared_ptr<std::string>> &frames = msg.prep_frames();
+        const T &child = msg.as_child();
+        bool win;
+        // queued messages go first; a new one may not overtake them
+        if (!m_outbox.empty() && flush())
+            win = m_outbox_max && park (with_hops (child, frames));
+        // once the first frame is in, the rest of the message can't be turned away (see send_frames())
+        else if (! (win = send_hops (child, frames.empty(), opts) && send_frames (frames, opts)) && m_outbox_max)
+            win = park (with_hops (child, frames));
+        if (m_cap && win)
+            m_cap->record (m_cap_id, OUTBOUND, frames.begin(), frames.end());
+        msg.unprep_frames();
+        return win;
+    }
+
+    template <class T>
+    bool Socket::send_hops (const T &msg, const bool last, const int opts)
+    {
+        const size_t n = msg.hop_count();
+        zmq::message_t z_msg;
+        for (size_t i = 0; i < n; i++)
         {
-            if (count < frames.size())
+            z_msg.copy (msg.hop (i));
+            if (!raw_sock().send (z_msg, (i + 1 < n || !last) ? (opts | ZMQ_SNDMORE) : opts))
             {
-                z_msg.rebuild ((void *)s->c_str(), s->size(), strp_free);
-                m_unsent[z_msg.data()] = s;
-                win &= raw_sock().send (z_msg, opts | ZMQ_SNDMORE);
-                count ++;
+                m_stats.would_block++;
+                return false;
             }
         }
-        //now send the last frame without enforcing the SNDMORE flag
-        z_msg.rebuild ((void *)frames.back()->c_str(), frames.back()->size(), strp_free);
-        m_unsent[z_msg.data()] = frames.back();
-        win &= raw_sock().send (z_msg, opts);
-        msg.unprep_frames();
-        return win;
+        return true;
+    }
+
+    template <class T>
+    std::list<std::shared_ptr<std::string>> Socket::with_hops (const T &msg, const std::list<std::shared_ptr<std::string>> &frames)
+    {
+        std::list<std::shared_ptr<std::string>> all (frames);
+        for (size_t i = msg.hop_count(); i > 0; i--)
+        {
+            zmq::message_t *h = msg.hop (i - 1);
+            all.push_front (std::make_shared<std::string> (static_cast<const char *> (h->data()), h->size()));
+        }
+        return all;
     }
 
     template <class T>
@@ -298,22 +611,136 @@ namespace zmqcpp
     {
         if (m_conn_endpts.size()) _conn();
         else _bind();
+        return do_recv<true> (msg, opts);
+    }
+
+    template <bool Multi, class T>
+    bool Socket::do_recv (BaseMessage<T> &msg, const int opts)
+    {
         bool win = true;
         static zmq::message_t z_msg;
         msg.start_recv();
-        int more;
+        // recv() appends, so this message's frames are the ones after these
+        const size_t before = msg.m_frames.size();
+        int more = 0;
         size_t msize = sizeof (more);
         do
         {
             z_msg.rebuild();
             win &= raw_sock().recv (&z_msg, opts);
-            msg.add_frame ((char *)z_msg.data(), z_msg.size());
-            raw_sock().getsockopt (ZMQ_RCVMORE, &more, &msize);
+            // routing frames the message keeps for itself never become body frames
+            if (!msg.as_child().take_frame (z_msg))
+            {
+                if (m_shm_threshold && ShmRing::is_desc (z_msg.data(), z_msg.size()))
+                {
+                    // a stale descriptor fails the message, but the rest of it still has to come off the socket
+                    std::shared_ptr<std::string> frame = ShmRing::try_open (z_msg.data());
+                    if (frame)
+                        msg.adopt_frame (frame);
+                    else
+                        win = false;
+                }
+                else
+                    msg.add_frame ((char *)z_msg.data(), z_msg.size());
+            }
+            if (Multi)
+                raw_sock().getsockopt (ZMQ_RCVMORE, &more, &msize);
         }
         while (more);
+        msg.end_recv();
+        if (!win)
+            msg.m_frames.resize (before);
+        if (m_cap && win)
+            m_cap->record (m_cap_id, INBOUND, std::next (msg.m_frames.begin(), before), msg.m_frames.end());
         return win;
     }
 
+    template <class T>
+    bool Socket::recv_into (BaseMessage<T> &msg, const int opts)
+    {
+        if (m_conn_endpts.size()) _conn();
+        else _bind();
+        return do_recv_into<true> (msg, opts);
+    }
+
+    template <bool Multi, class T>
+    bool Socket::do_recv_into (BaseMessage<T> &msg, const int opts)
+    {
+        zmq::message_t z_msg;
+        msg.start_recv();
+        msg.recycle_frames();
+        bool stale = false;
+        int more = 0;
+        size_t msize = sizeof (more);
+        do
+        {
+            if (!raw_sock().recv (&z_msg, opts))
+                return false;
+            if (!msg.as_child().take_frame (z_msg))
+            {
+                if (m_shm_threshold && ShmRing::is_desc (z_msg.data(), z_msg.size()))
+                {
+                    // as in do_recv(): fail the message, but read all of it
+                    std::shared_ptr<std::string> frame = ShmRing::try_open (z_msg.data());
+                    if (frame)
+                        msg.adopt_frame (frame);
+                    else
+                        stale = true;
+                }
+                else
+                    msg.refill_frame ((char *)z_msg.data(), z_msg.size());
+            }
+            if (Multi)
+                raw_sock().getsockopt (ZMQ_RCVMORE, &more, &msize);
+        }
+        while (more);
+        msg.end_recv();
+        if (stale)
+            return false;
+        if (m_cap)
+            m_cap->record (m_cap_id, INBOUND, msg.m_frames.begin(), msg.m_frames.end());
+        return true;
+    }
+
+    template <class F>
+    bool Socket::recv_frames (F fn, const int opts)
+    {
+        if (m_conn_endpts.size()) _conn();
+        else _bind();
+        return do_recv_frames<true> (fn, opts);
+    }
+
+    template <bool Multi, class F>
+    bool Socket::do_recv_frames (F fn, const int opts)
+    {
+        zmq::message_t z_msg;
+        int more = 0;
+        size_t msize = sizeof (more);
+        do
+        {
+            if (!raw_sock().recv (&z_msg, opts))
+                return false;
+            if (Multi)
+                raw_sock().getsockopt (ZMQ_RCVMORE, &more, &msize);
+            switch (fn (const_buffer {z_msg.data(), z_msg.size()}, more != 0))
+            {
+                case FRAME_STOP:
+                    return true;
+                case FRAME_SKIP:
+                    while (more)
+                    {
+                        raw_sock().recv (&z_msg, opts);
+                        raw_sock().getsockopt (ZMQ_RCVMORE, &more, &msize);
+                    }
+                    return true;
+                default:
+                    break;
+            }
+        }
+        while (more);
+        return true;
+    }
+
     template <class T>
     Socket &operator >> (Socket &sock, BaseMessage<T> &data)
     {
@@ -0,0 +1,257 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file alloc.cpp
+ * \author Nathan Eloe
+ * \brief checks that steady-state send/recv_into doesn't touch the heap
+ *
+ * Built into its own executable because it replaces operator new and malloc for the whole process.
+ * Only allocations made on the test's own thread while counting is switched on are counted, so
+ * libzmq's I/O threads don't show up.
+ */
+
+#include "../zmqcpp.h"
+#include "gtest/gtest.h"
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+#include <zmq.hpp>
+
+extern "C" void *__libc_malloc (size_t size);
+
+static thread_local bool counting = false;
+static thread_local size_t news = 0;
+static thread_local size_t mallocs = 0;
+static thread_local size_t malloc_bytes = 0;
+
+extern "C" void *malloc (size_t size)
+{
+    if (counting)
+    {
+        mallocs++;
+        malloc_bytes += size;
+    }
+    return __libc_malloc (size);
+}
+
+void *operator new (size_t size)
+{
+    if (counting)
+        news++;
+    void *p = __libc_malloc (size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+void *operator new[] (size_t size)
+{
+    return operator new (size);
+}
+void *operator new (size_t size, const std::nothrow_t &) noexcept
+{
+    if (counting)
+        news++;
+    return __libc_malloc (size ? size : 1);
+}
+void *operator new[] (size_t size, const std::nothrow_t &t) noexcept
+{
+    return operator new (size, t);
+}
+void operator delete (void *p) noexcept
+{
+    free (p);
+}
+void operator delete[] (void *p) noexcept
+{
+    free (p);
+}
+void operator delete (void *p, size_t) noexcept
+{
+    free (p);
+}
+void operator delete[] (void *p, size_t) noexcept
+{
+    free (p);
+}
+
+const int WARMUP = 100;
+const int ITERS = 1000;
+
+// pulls every part of one message off the socket
+static void drain (zmqcpp::Socket &sock, zmq::message_t &z_msg)
+{
+    int more;
+    size_t msize = sizeof (more);
+    do
+    {
+        sock.raw_sock().recv (&z_msg);
+        sock.raw_sock().getsockopt (ZMQ_RCVMORE, &more, &msize);
+    }
+    while (more);
+}
+
+// send and receive in lockstep so libzmq's pipes never have to grow
+static void pingpong (zmqcpp::Socket &send, zmqcpp::Socket &recv, const zmqcpp::Message &m)
+{
+    zmq::message_t z_msg;
+    for (int i = 0; i < WARMUP; i++)
+    {
+        send.send (m);
+        drain (recv, z_msg);
+    }
+    news = mallocs = malloc_bytes = 0;
+    counting = true;
+    for (int i = 0; i < ITERS; i++)
+    {
+        send.send (m);
+        drain (recv, z_msg);
+    }
+    counting = false;
+}
+
+// same as pingpong, but through the copying sendv()
+static void pingpongv (zmqcpp::Socket &send, zmqcpp::Socket &recv, const std::vector<zmqcpp::const_buffer> &bufs)
+{
+    zmq::message_t z_msg;
+    for (int i = 0; i < WARMUP; i++)
+    {
+        send.sendv (bufs);
+        drain (recv, z_msg);
+    }
+    news = mallocs = malloc_bytes = 0;
+    counting = true;
+    for (int i = 0; i < ITERS; i++)
+    {
+        send.sendv (bufs);
+        drain (recv, z_msg);
+    }
+    counting = false;
+}
+
+// same as pingpong, but the receiving side goes through recv_into a reused Message
+static void roundtrip (zmqcpp::Socket &send, zmqcpp::Socket &recv, const zmqcpp::Message &m)
+{
+    zmqcpp::Message in;
+    for (int i = 0; i < WARMUP; i++)
+    {
+        send.send (m);
+        recv.recv_into (in);
+    }
+    news = mallocs = malloc_bytes = 0;
+    counting = true;
+    for (int i = 0; i < ITERS; i++)
+    {
+        send.send (m);
+        recv.recv_into (in);
+    }
+    counting = false;
+    ASSERT_EQ (* (m.frames().back()), in.last());
+}
+
+TEST (AllocTest, SendInlineFrames)
+{
+    zmqcpp::Socket send (ZMQ_PUSH);
+    zmqcpp::Socket recv (ZMQ_PULL);
+    send.bind ("tcp://*:5563");
+    recv.connect ("tcp://localhost:5563");
+    recv._conn();
+    zmqcpp::Message m;
+    m.add_frame ("tick");
+    m.add_frame ("12345678");
+    pingpong (send, recv, m);
+    // small frames live inside the zmq_msg_t, so neither we nor libzmq allocate
+    ASSERT_EQ (0, news);
+    ASSERT_EQ (0, mallocs);
+}
+
+TEST (AllocTest, SendLargeFrames)
+{
+    zmqcpp::Socket send (ZMQ_PUSH);
+    zmqcpp::Socket recv (ZMQ_PULL);
+    send.bind ("tcp://*:5564");
+    recv.connect ("tcp://localhost:5564");
+    recv._conn();
+    zmqcpp::Message m;
+    m.add_frame ("tick");
+    m.add_frame (std::string (4096, 'x'));
+    pingpong (send, recv, m);
+    // libzmq still mallocs a small refcount header per zero-copy frame; that's its business, not ours
+    ASSERT_EQ (0, news);
+}
+
+TEST (AllocTest, SendThroughPool)
+{
+    static zmqcpp::BufferPool pool;
+    const std::string big (4096, 'x');
+    const std::vector<zmqcpp::const_buffer> bufs = {zmqcpp::buffer ("tick", 4), zmqcpp::buffer (big)};
+
+    // without a pool, each copied frame is one zmq_msg_init_size malloc with the payload in it
+    zmqcpp::Socket send (ZMQ_PUSH);
+    zmqcpp::Socket recv (ZMQ_PULL);
+    send.bind ("tcp://*:5565");
+    recv.connect ("tcp://localhost:5565");
+    recv._conn();
+    pingpongv (send, recv, bufs);
+    ASSERT_EQ (0, news);
+    const size_t plain_mallocs = mallocs, plain_bytes = malloc_bytes;
+    ASSERT_LE (ITERS * big.size(), plain_bytes);
+
+    // with one, the payload comes from the pool; zmq_msg_init_data still mallocs its small refcount
+    // header for every zero-copy frame (the public libzmq API has no way around it), so the number of
+    // mallocs stays the same and only their size drops
+    zmqcpp::Socket psend (ZMQ_PUSH);
+    zmqcpp::Socket precv (ZMQ_PULL);
+    psend.bind ("tcp://*:5596");
+    precv.connect ("tcp://localhost:5596");
+    precv._conn();
+    psend.use_pool (&pool);
+    pingpongv (psend, precv, bufs);
+    ASSERT_EQ (0, news);
+    ASSERT_GE (plain_mallocs, mallocs);
+    ASSERT_GT (ITERS * 256, malloc_bytes);
+}
+
+TEST (AllocTest, RecvIntoInlineFrames)
+{
+    zmqcpp::Socket send (ZMQ_PUSH);
+    zmqcpp::Socket recv (ZMQ_PULL);
+    send.bind ("tcp://*:5566");
+    recv.connect ("tcp://localhost:5566");
+    recv._conn();
+    zmqcpp::Message m;
+    m.add_frame ("tick");
+    m.add_frame ("12345678");
+    roundtrip (send, recv, m);
+    ASSERT_EQ (0, news);
+    ASSERT_EQ (0, mallocs);
+}
+
+TEST (AllocTest, RecvIntoLargeFrames)
+{
+    zmqcpp::Socket send (ZMQ_PUSH);
+    zmqcpp::Socket recv (ZMQ_PULL);
+    send.bind ("tcp://*:5567");
+    recv.connect ("tcp://localhost:5567");
+    recv._conn();
+    zmqcpp::Message m;
+    m.add_frame ("tick");
+    m.add_frame (std::string (4096, 'x'));
+    roundtrip (send, recv, m);
+    ASSERT_EQ (0, news);
+}
@@ -0,0 +1,139 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file batch.cpp
+ * \author Nathan Eloe
+ * \brief tests batch messages and the batching RPC client and server
+ */
+
+#include "../zmqcpp.h"
+#include "../messages/batch.h"
+#include "../patterns/batch.h"
+#include "gtest/gtest.h"
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST (Batch, Calls)
+{
+    zmqcpp::BatchMessage msg;
+    msg.add_call (7, "seven");
+    msg.add_call (9, std::string ("\0nine", 5));
+    EXPECT_EQ (2, msg.calls());
+    std::vector<uint32_t> ids;
+    std::vector<std::string> payloads;
+    EXPECT_TRUE (msg.for_each_call ([&] (const uint32_t id, const zmqcpp::const_buffer & p)
+    {
+        ids.push_back (id);
+        payloads.push_back (std::string (static_cast<const char *> (p.data), p.size));
+    }));
+    EXPECT_EQ (std::vector<uint32_t> ({7, 9}), ids);
+    EXPECT_EQ ("seven", payloads[0]);
+    EXPECT_EQ (std::string ("\0nine", 5), payloads[1]);
+
+    // an id frame of the wrong size is rejected
+    zmqcpp::BatchMessage bad;
+    bad.add_frame ("xx");
+    bad.add_frame ("payload");
+    EXPECT_FALSE (bad.for_each_call ([] (const uint32_t, const zmqcpp::const_buffer &) {}));
+}
+
+TEST (Batch, ManyCallsFewMessages)
+{
+    std::atomic<bool> done (false);
+    std::atomic<uint64_t> batches (0), malformed (0);
+    std::thread server ([&]
+    {
+        zmqcpp::BatchServer srv ("tcp://*:5591", [] (const zmqcpp::const_buffer & p)
+        {
+            const std::string s (static_cast<const char *> (p.data), p.size);
+            if (s == "throw")
+                throw std::runtime_error ("bad call");
+            return s + "!";
+        }, 4);
+        while (!done)
+        {
+            srv.serve_once (10);
+            malformed = srv.malformed();
+        }
+        batches = srv.batches();
+    });
+
+    {
+        // a long window, so the batch goes out once it is full
+        zmqcpp::BatchClient client ("tcp://localhost:5591", 16, std::chrono::microseconds (500000));
+        std::vector<std::future<std::string>> results;
+        std::vector<std::thread> callers;
+        std::mutex lock;
+        for (int t = 0; t < 4; t++)
+            callers.emplace_back ([&, t]
+        {
+            for (int i = 0; i < 4; i++)
+            {
+                std::future<std::string> f = client.call (std::to_string (t * 4 + i));
+                std::lock_guard<std::mutex> hold (lock);
+                results.push_back (std::move (f));
+            }
+        });
+        for (std::thread &c : callers)
+            c.join();
+        std::vector<bool> seen (16, false);
+        for (std::future<std::string> &f : results)
+        {
+            ASSERT_EQ (std::future_status::ready, f.wait_for (std::chrono::seconds (5)));
+            const std::string r = f.get();
+            ASSERT_EQ ('!', r.back());
+            seen[std::stoi (r.substr (0, r.size() - 1))] = true;
+        }
+        for (int i = 0; i < 16; i++)
+            EXPECT_TRUE (seen[i]);
+
+        // a lone call goes out when its window closes; a handler that throws answers empty
+        zmqcpp::BatchClient quick ("tcp://localhost:5591", 16, std::chrono::microseconds (1000));
+        std::future<std::string> f = quick.call ("throw");
+        ASSERT_EQ (std::future_status::ready, f.wait_for (std::chrono::seconds (5)));
+        EXPECT_EQ ("", f.get());
+
+        // frames that aren't [id][payload] pairs are dropped unanswered, and counted
+        zmqcpp::Socket raw (ZMQ_DEALER);
+        raw.connect ("tcp://localhost:5591");
+        zmqcpp::Message odd;
+        odd.add_frame ("odd");
+        raw.send (odd);
+        for (int i = 0; i < 500 && !malformed; i++)
+            std::this_thread::sleep_for (std::chrono::milliseconds (10));
+        EXPECT_EQ (1, malformed);
+    }
+    done = true;
+    server.join();
+    EXPECT_EQ (2, batches);
+}
+
+TEST (Batch, Timeout)
+{
+    // nobody is listening
+    zmqcpp::BatchClient client ("tcp://localhost:5592", 4, std::chrono::microseconds (100), std::chrono::milliseconds (50));
+    std::future<std::string> f = client.call ("anyone?");
+    ASSERT_EQ (std::future_status::ready, f.wait_for (std::chrono::seconds (5)));
+    EXPECT_THROW (f.get(), std::runtime_error);
+}
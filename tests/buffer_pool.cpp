@@ -0,0 +1,74 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file buffer_pool.cpp
+ * \author Nathan Eloe
+ * \brief tests the size-class buffer pool
+ */
+
+#include "../zmqcpp.h"
+#include "gtest/gtest.h"
+#include <string>
+#include <thread>
+#include <zmq.hpp>
+
+const char BIND[] = "tcp://*:5562";
+const char CONN[] = "tcp://localhost:5562";
+
+TEST (BufferPoolTest, ReusesBlocks)
+{
+    zmqcpp::BufferPool pool;
+    void *a = pool.acquire (100);
+    zmqcpp::BufferPool::release (a, nullptr);
+    // same size class, same thread: the block comes straight back
+    ASSERT_EQ (a, pool.acquire (120));
+    void *big = pool.acquire (zmqcpp::BufferPool::MAX_BLOCK + 1);
+    ASSERT_NE (nullptr, big);
+    zmqcpp::BufferPool::release (big, nullptr);
+}
+
+TEST (BufferPoolTest, ReleaseFromOtherThread)
+{
+    zmqcpp::BufferPool pool;
+    void *a = pool.acquire (1000);
+    std::thread t ([a]()
+    {
+        zmqcpp::BufferPool::release (a, nullptr);
+    });
+    t.join();
+    ASSERT_EQ (a, pool.acquire (1000));
+}
+
+TEST (BufferPoolTest, SendThroughPool)
+{
+    static zmqcpp::BufferPool pool;
+    zmqcpp::Socket send (ZMQ_PUSH);
+    zmqcpp::Socket recv (ZMQ_PULL);
+    send.bind (BIND);
+    recv.connect (CONN);
+    recv._conn();
+    send.use_pool (&pool);
+    const std::string DATA (4096, 'x');
+    zmqcpp::Message mesg, recvd;
+    mesg.add_frame ("hdr");
+    mesg.add_frame (DATA);
+    ASSERT_TRUE (send.send (mesg));
+    ASSERT_TRUE (recv.recv (recvd));
+    ASSERT_EQ ("hdr", recvd.first());
+    ASSERT_EQ (DATA, recvd.last());
+}
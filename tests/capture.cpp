@@ -0,0 +1,90 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file capture.cpp
+ * \author Nathan Eloe
+ * \brief tests the traffic capture log
+ */
+
+#include "../zmqcpp.h"
+#include "gtest/gtest.h"
+#include <string>
+#include <zmq.hpp>
+
+namespace
+{
+    std::string str (const zmqcpp::const_buffer &b)
+    {
+        return std::string (static_cast<const char *> (b.data), b.size);
+    }
+}
+
+TEST (CaptureTest, TeeSendAndRecv)
+{
+    const char *LOG = "zmqcpp-capture-test.log";
+    {
+        zmqcpp::Capture cap (LOG, 1024 * 1024);
+        zmqcpp::Socket send (ZMQ_PUSH);
+        zmqcpp::Socket recv (ZMQ_PULL);
+        send.bind ("tcp://*:5571");
+        recv.connect ("tcp://localhost:5571");
+        send.capture (&cap, 1);
+        recv.capture (&cap, 2);
+        zmqcpp::Message mesg, recvd;
+        mesg.add_frame ("hdr");
+        mesg.add_frame (std::string (1000, 'x'));
+        ASSERT_TRUE (send.send (mesg));
+        ASSERT_TRUE (recv.recv (recvd));
+        const std::string one = "one", two = "two";
+        const std::vector<zmqcpp::const_buffer> bufs = {zmqcpp::buffer (one), zmqcpp::buffer (two)};
+        ASSERT_TRUE (send.sendv (bufs));
+        ASSERT_TRUE (recv.recv_into (recvd));
+        ASSERT_EQ (0, cap.dropped());
+    }
+    zmqcpp::CaptureReader log (LOG);
+    zmqcpp::capture_record rec;
+    const uint32_t ids[] = {1, 2, 1, 2};
+    const std::string firsts[] = {"hdr", "hdr", "one", "one"};
+    uint64_t last_ts = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        ASSERT_TRUE (log.next (rec));
+        ASSERT_EQ (ids[i], rec.sock_id);
+        ASSERT_EQ ((i % 2) ? zmqcpp::INBOUND : zmqcpp::OUTBOUND, rec.dir);
+        ASSERT_EQ (2, rec.frames.size());
+        ASSERT_EQ (firsts[i], str (rec.frames[0]));
+        ASSERT_LE (last_ts, rec.ts_ns);
+        last_ts = rec.ts_ns;
+    }
+    ASSERT_FALSE (log.next (rec));
+    log.rewind();
+    ASSERT_TRUE (log.next (rec));
+    ASSERT_EQ (std::string (1000, 'x'), str (rec.frames[1]));
+}
+
+TEST (CaptureTest, FullLogDrops)
+{
+    zmqcpp::Capture cap ("zmqcpp-capture-full.log", 4096);
+    const std::string big (1000, 'y');
+    const zmqcpp::const_buffer b = zmqcpp::buffer (big);
+    int kept = 0;
+    for (int i = 0; i < 10; i++)
+        kept += cap.record (0, zmqcpp::OUTBOUND, &b, 1);
+    ASSERT_EQ (3, kept);
+    ASSERT_EQ (7, cap.dropped());
+}
@@ -0,0 +1,147 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file coalesce.cpp
+ * \author Nathan Eloe
+ * \brief tests packing small messages into one frame, unpacking them, and tuning the packing to the load
+ */
+
+#include "../zmqcpp.h"
+#include "../patterns/coalesce.h"
+#include "../patterns/coalesce_control.h"
+#include "gtest/gtest.h"
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST (Coalesce, Unpack)
+{
+    // lengths of 3 and 200 (a two-byte varint)
+    std::string frame ("\x03" "abc" "\xc8\x01", 6);
+    frame.append (200, 'x');
+    std::vector<std::string> got;
+    EXPECT_TRUE (zmqcpp::unpack_coalesced (zmqcpp::buffer (frame), [&] (const zmqcpp::const_buffer & m)
+    {
+        got.push_back (std::string (static_cast<const char *> (m.data), m.size));
+    }));
+    ASSERT_EQ (2, got.size());
+    EXPECT_EQ ("abc", got[0]);
+    EXPECT_EQ (std::string (200, 'x'), got[1]);
+
+    // a length running past the end
+    got.clear();
+    EXPECT_FALSE (zmqcpp::unpack_coalesced (zmqcpp::buffer (std::string ("\x02" "a" "\x05" "b", 4)), [&] (const zmqcpp::const_buffer & m)
+    {
+        got.push_back (std::string (static_cast<const char *> (m.data), m.size));
+    }));
+    EXPECT_EQ (1, got.size());
+}
+
+TEST (Coalesce, PackedAndPlain)
+{
+    zmqcpp::Socket pull (ZMQ_PULL), push (ZMQ_PUSH);
+    pull.bind ("tcp://*:5593");
+    push.connect ("tcp://localhost:5593");
+    zmqcpp::Coalescer out (push, 8192, std::chrono::microseconds (10000000), 512);
+
+    std::vector<std::string> sent;
+    for (int i = 0; i < 100; i++)
+    {
+        sent.push_back ("point " + std::to_string (i));
+        EXPECT_TRUE (out.send (sent.back()));
+    }
+    EXPECT_EQ (100, out.pending());
+    // a big message pushes the batch out ahead of itself
+    sent.push_back (std::string (4096, 'B'));
+    EXPECT_TRUE (out.send (sent.back()));
+    EXPECT_EQ (0, out.pending());
+    // a batch of one goes out plain
+    sent.push_back ("alone");
+    EXPECT_TRUE (out.send (sent.back()));
+    EXPECT_TRUE (out.flush());
+    EXPECT_EQ (102, out.stats().messages);
+    EXPECT_EQ (1, out.stats().packed);
+    EXPECT_EQ (2, out.stats().plain);
+
+    std::vector<std::string> got;
+    for (int i = 0; i < 3; i++)
+        EXPECT_TRUE (zmqcpp::recv_coalesced (pull, [&] (const zmqcpp::const_buffer & m)
+    {
+        got.push_back (std::string (static_cast<const char *> (m.data), m.size));
+    }));
+    EXPECT_EQ (sent, got);
+}
+
+TEST (Coalesce, ByteBudget)
+{
+    zmqcpp::Socket pull (ZMQ_PULL), push (ZMQ_PUSH);
+    pull.bind ("tcp://*:5594");
+    push.connect ("tcp://localhost:5594");
+    // 11 bytes a message (10 + its length), so 9 fit in 100
+    zmqcpp::Coalescer out (push, 100, std::chrono::microseconds (10000000), 64);
+    for (int i = 0; i < 10; i++)
+        out.send (std::string (10, 'a' + i));
+    EXPECT_EQ (1, out.stats().packed);
+    EXPECT_EQ (1, out.pending());
+
+    size_t count = 0;
+    EXPECT_TRUE (zmqcpp::recv_coalesced (pull, [&] (const zmqcpp::const_buffer &)
+    {
+        count++;
+    }));
+    EXPECT_EQ (9, count);
+}
+
+TEST (Coalesce, ControllerFollowsPressure)
+{
+    // a bound PUSH with no peers isn't writable
+    zmqcpp::Socket push (ZMQ_PUSH);
+    push.bind ("tcp://*:5595");
+    zmqcpp::Coalescer out (push);
+    const zmqcpp::coalesce_limits lim = {256, 4352, std::chrono::microseconds (0), std::chrono::microseconds (1600),
+                                         std::chrono::microseconds (1000)};
+    zmqcpp::CoalesceController ctl (out, lim, std::chrono::microseconds (0));
+    EXPECT_EQ (256, out.stats().max_bytes);
+    EXPECT_EQ (0, out.stats().window_us);
+
+    // additive steps of a sixteenth of the range, up to the top
+    EXPECT_TRUE (ctl.update());
+    EXPECT_EQ (512, out.stats().max_bytes);
+    EXPECT_EQ (100, out.stats().window_us);
+    for (int i = 0; i < 20; i++)
+        ctl.update();
+    EXPECT_EQ (4352, out.max_bytes());
+    EXPECT_EQ (1600, out.window().count());
+    EXPECT_EQ (16, ctl.stats().increases);
+
+    // once a peer is there to take messages, the limits halve back down
+    zmqcpp::Socket pull (ZMQ_PULL);
+    pull.connect ("tcp://localhost:5595");
+    pull._conn();
+    for (int i = 0; i < 100 && !push.writable(); i++)
+        std::this_thread::sleep_for (std::chrono::milliseconds (10));
+    ASSERT_TRUE (push.writable());
+    EXPECT_TRUE (ctl.update());
+    EXPECT_EQ (2176, out.stats().max_bytes);
+    EXPECT_EQ (800, out.stats().window_us);
+    for (int i = 0; i < 20; i++)
+        ctl.update();
+    EXPECT_EQ (256, out.max_bytes());
+    EXPECT_EQ (0, out.window().count());
+}
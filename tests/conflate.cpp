@@ -0,0 +1,70 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file conflate.cpp
+ * \author Nathan Eloe
+ * \brief tests the conflating subscriber
+ */
+
+#include "../zmqcpp.h"
+#include "../patterns/conflate.h"
+#include "gtest/gtest.h"
+#include <map>
+#include <string>
+
+static void publish (zmqcpp::Socket &pub, const std::string &topic, const std::string &body)
+{
+    zmqcpp::Message m;
+    m.add_frame (topic);
+    m.add_frame (body);
+    pub.send (m);
+}
+
+TEST (Conflate, KeepsNewestPerTopic)
+{
+    zmqcpp::Socket pub (ZMQ_PUB);
+    pub.bind ("tcp://*:5584");
+    zmqcpp::ConflatingSubscriber sub ("tcp://localhost:5584");
+    sub.subscribe ("");
+    // wait out the slow joiner, then take in any extra warm-up messages
+    for (int i = 0; i < 100 && !sub.poll (10); i++)
+        publish (pub, "warm", "up");
+    while (sub.poll (50))
+        sub.drain ([] (zmqcpp::Message &) {});
+    const uint64_t base = sub.received();
+
+    for (int i = 0; i < 10; i++)
+        publish (pub, "a", std::to_string (i));
+    for (int i = 0; i < 3; i++)
+        publish (pub, "b", std::to_string (i));
+    for (int i = 0; i < 100 && sub.received() < base + 13; i++)
+        sub.poll (10);
+    ASSERT_EQ (base + 13, sub.received());
+    EXPECT_EQ (2, sub.pending());
+
+    std::map<std::string, std::string> got;
+    EXPECT_EQ (2, sub.drain ([&got] (zmqcpp::Message & m)
+    {
+        got[m.first()] = m.last();
+    }));
+    EXPECT_EQ ("9", got["a"]);
+    EXPECT_EQ ("2", got["b"]);
+    EXPECT_LE (11, sub.conflated());
+    EXPECT_EQ (0, sub.pending());
+    EXPECT_EQ (0, sub.drain ([] (zmqcpp::Message &) {}));
+}
@@ -0,0 +1,99 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file hedge.cpp
+ * \author Nathan Eloe
+ * \brief tests the latency histogram and the hedging request client
+ */
+
+#include "../zmqcpp.h"
+#include "../patterns/hedge.h"
+#include "gtest/gtest.h"
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+TEST (Hedge, Histogram)
+{
+    zmqcpp::LatencyHistogram h;
+    EXPECT_EQ (0, h.percentile (0.5));
+    for (uint64_t v = 1; v <= 1000; v++)
+        h.record (v);
+    EXPECT_EQ (1000, h.count());
+    // every bucket is within 12.5% of the values in it, and the answer is its upper edge
+    EXPECT_LE (500, h.percentile (0.5));
+    EXPECT_GE (563, h.percentile (0.5));
+    EXPECT_LE (950, h.percentile (0.95));
+    EXPECT_GE (1069, h.percentile (0.95));
+    // halving rounds each bucket down
+    h.decay();
+    EXPECT_GE (500, h.count());
+    EXPECT_LE (490, h.count());
+
+    zmqcpp::LatencyHistogram small;
+    for (int i = 0; i < 10; i++)
+        small.record (3);
+    EXPECT_EQ (3, small.percentile (1.0));
+}
+
+// a REP server that answers every request with its name, after a delay
+static void serve (const char *endpt, const std::string name, const int delay_ms, std::atomic<bool> &done)
+{
+    zmqcpp::Socket rep (ZMQ_REP);
+    rep.bind (endpt);
+    rep._bind();
+    zmqcpp::Message req;
+    while (!done)
+    {
+        zmq_pollitem_t item = {(void *) rep.raw_sock(), 0, ZMQ_POLLIN, 0};
+        if (zmq::poll (&item, 1, 10) <= 0)
+            continue;
+        rep.recv_into (req);
+        std::this_thread::sleep_for (std::chrono::milliseconds (delay_ms));
+        zmqcpp::Message reply;
+        reply.add_frame (name);
+        rep.send (reply);
+    }
+}
+
+TEST (Hedge, SlowBackendIsHedged)
+{
+    std::atomic<bool> done (false);
+    std::thread slow (serve, "tcp://*:5585", "slow", 300, std::ref (done));
+    std::thread fast (serve, "tcp://*:5586", "fast", 0, std::ref (done));
+    // hedge after 20ms until there are enough reply times to go on
+    zmqcpp::HedgedClient client ({"tcp://localhost:5585", "tcp://localhost:5586"}, 0.95, 20000);
+    zmqcpp::Message req, reply;
+    req.add_frame ("ping");
+    // the first and third requests go to the slow backend first
+    for (int i = 0; i < 3; i++)
+    {
+        ASSERT_TRUE (client.request (req, reply));
+        EXPECT_EQ ("fast", reply.last());
+    }
+    const zmqcpp::hedge_stats &st = client.stats();
+    EXPECT_EQ (3, st.requests);
+    EXPECT_EQ (2, st.hedged);
+    EXPECT_EQ (2, st.hedge_wins);
+    EXPECT_EQ (0, st.timeouts);
+    EXPECT_EQ (3, client.latencies().count());
+    done = true;
+    slow.join();
+    fast.join();
+}
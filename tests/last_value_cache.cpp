@@ -0,0 +1,104 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file last_value_cache.cpp
+ * \author Nathan Eloe
+ * \brief tests the last value cache's replay, eviction and snapshots
+ */
+
+#include "../zmqcpp.h"
+#include "../patterns/last_value_cache.h"
+#include "gtest/gtest.h"
+#include <atomic>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+static void publish (zmqcpp::Socket &pub, const std::string &topic, const std::string &body)
+{
+    zmqcpp::Message m;
+    m.add_frame (topic);
+    m.add_frame (body);
+    pub.send (m);
+}
+
+TEST (LastValueCache, ReplayAndSnapshot)
+{
+    // each entry is 8 bytes (3 for the topic, 2 for the body, 3 for the key), so three fit
+    zmqcpp::LastValueCache lvc ("tcp://*:5580", "tcp://*:5581", "tcp://*:5582", 24);
+    zmqcpp::Socket pub (ZMQ_PUB);
+    pub.connect ("tcp://localhost:5580");
+    for (int i = 0; i < 100 && lvc.size() < 2; i++)
+    {
+        publish (pub, "k.1", "v1");
+        publish (pub, "k.2", "v2");
+        lvc.serve_once (10);
+    }
+    ASSERT_EQ (2, lvc.size());
+    // take in the extra copies the retries sent, so k.1 is the least recently updated
+    bool busy = true;
+    while (busy)
+        busy = lvc.serve_once (50);
+
+    // a late subscriber gets both without anything new being published
+    zmqcpp::Socket sub (ZMQ_SUB);
+    sub.connect ("tcp://localhost:5581");
+    sub._conn();
+    sub.raw_sock().setsockopt (ZMQ_SUBSCRIBE, "k.", 2);
+    std::map<std::string, std::string> got;
+    zmqcpp::Message m;
+    for (int i = 0; i < 100 && got.size() < 2; i++)
+    {
+        lvc.serve_once (10);
+        while (sub.recv_into (m, ZMQ_DONTWAIT))
+            got[m.first()] = m.last();
+    }
+    EXPECT_EQ (2, got.size());
+    EXPECT_EQ ("v1", got["k.1"]);
+    EXPECT_EQ ("v2", got["k.2"]);
+    EXPECT_LE (2, lvc.replayed());
+
+    // the fourth topic pushes out the least recently updated one
+    const uint64_t before = lvc.updates();
+    publish (pub, "k.3", "v3");
+    publish (pub, "k.4", "v4");
+    for (int i = 0; i < 100 && lvc.updates() < before + 2; i++)
+        lvc.serve_once (10);
+    EXPECT_EQ (3, lvc.size());
+    EXPECT_EQ (24, lvc.bytes());
+    EXPECT_EQ (1, lvc.evicted());
+
+    std::atomic<bool> done (false);
+    std::thread server ([&]()
+    {
+        while (!done)
+            lvc.serve_once (10);
+    });
+    std::vector<std::string> topics;
+    EXPECT_TRUE (zmqcpp::fetch_snapshot ("tcp://localhost:5582", "k.", [&topics] (zmqcpp::Message & msg)
+    {
+        topics.push_back (msg.first());
+    }));
+    done = true;
+    server.join();
+    ASSERT_EQ (3, topics.size());
+    EXPECT_EQ ("k.2", topics[0]);
+    EXPECT_EQ ("k.3", topics[1]);
+    EXPECT_EQ ("k.4", topics[2]);
+}
@@ -0,0 +1,274 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file load_balancer.cpp
+ * \author Nathan Eloe
+ * \brief tests the least-outstanding-requests broker and the key-affinity router
+ */
+
+#include "../zmqcpp.h"
+#include "../patterns/affinity.h"
+#include "../patterns/load_balancer.h"
+#include "gtest/gtest.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+// a worker that answers every request with its name after delay_ms, heartbeating while idle
+static void work (const char *endpt, const std::string name, const int delay_ms, std::atomic<bool> &done)
+{
+    zmqcpp::Socket sock (ZMQ_DEALER);
+    sock.connect (endpt);
+    zmqcpp::Message ready;
+    ready.add_frame (zmqcpp::LoadBalancer::READY);
+    sock.send (ready);
+    zmqcpp::EnvelopeMessage req, reply;
+    while (!done)
+    {
+        zmq_pollitem_t item = {(void *) sock.raw_sock(), 0, ZMQ_POLLIN, 0};
+        if (zmq::poll (&item, 1, 50) <= 0)
+        {
+            zmqcpp::Message beat;
+            beat.add_frame (zmqcpp::LoadBalancer::HEARTBEAT);
+            sock.send (beat);
+            continue;
+        }
+        sock.recv_into (req);
+        std::this_thread::sleep_for (std::chrono::milliseconds (delay_ms));
+        reply.copy_envelope (req);
+        reply.clear();
+        reply.add_frame (name);
+        sock.send (reply);
+    }
+}
+
+TEST (LoadBalancer, LeastOutstanding)
+{
+    // two requests in flight per worker at most
+    zmqcpp::LoadBalancer lb ("tcp://*:5587", "tcp://*:5588", std::chrono::milliseconds (300), 2);
+    std::atomic<bool> done (false);
+    std::thread slow (work, "tcp://localhost:5588", "slow", 100, std::ref (done));
+    std::thread fast (work, "tcp://localhost:5588", "fast", 0, std::ref (done));
+    for (int i = 0; i < 200 && lb.workers().size() < 2; i++)
+        lb.serve_once (10);
+    ASSERT_EQ (2, lb.workers().size());
+
+    zmqcpp::Socket client (ZMQ_DEALER);
+    client.connect ("tcp://localhost:5587");
+    for (int i = 0; i < 10; i++)
+    {
+        zmqcpp::Message req;
+        req.add_frame ("");
+        req.add_frame (std::to_string (i));
+        client.send (req);
+    }
+    std::map<std::string, int> by;
+    zmqcpp::Message rep;
+    for (int i = 0; i < 500 && by["slow"] + by["fast"] < 10; i++)
+    {
+        lb.serve_once (10);
+        while (client.recv_into (rep, ZMQ_DONTWAIT))
+            by[rep.last()]++;
+    }
+    EXPECT_EQ (10, by["slow"] + by["fast"]);
+    // the slow worker is still on its first requests while the fast one clears the rest
+    EXPECT_GT (by["fast"], by["slow"]);
+    EXPECT_EQ (10, lb.stats().requests);
+    EXPECT_EQ (10, lb.stats().replies);
+    for (const zmqcpp::LoadBalancer::worker &w : lb.workers())
+        EXPECT_EQ (0, w.outstanding);
+
+    // a worker that stops heartbeating is dropped
+    zmqcpp::Socket mute (ZMQ_DEALER);
+    mute.connect ("tcp://localhost:5588");
+    zmqcpp::Message ready;
+    ready.add_frame (zmqcpp::LoadBalancer::READY);
+    mute.send (ready);
+    for (int i = 0; i < 100 && lb.workers().size() < 3; i++)
+        lb.serve_once (10);
+    ASSERT_EQ (3, lb.workers().size());
+    for (int i = 0; i < 100 && lb.workers().size() > 2; i++)
+        lb.serve_once (10);
+    EXPECT_EQ (2, lb.workers().size());
+    EXPECT_EQ (1, lb.stats().expired);
+    // ...and taken back once it is heard from again
+    zmqcpp::Message beat;
+    beat.add_frame (zmqcpp::LoadBalancer::HEARTBEAT);
+    mute.send (beat);
+    for (int i = 0; i < 100 && lb.workers().size() < 3; i++)
+        lb.serve_once (10);
+    EXPECT_EQ (3, lb.workers().size());
+
+    done = true;
+    slow.join();
+    fast.join();
+}
+
+// a worker that takes one request and leaves without answering it (its socket closes with the thread)
+static void take_one (const char *endpt, std::atomic<bool> &got)
+{
+    zmqcpp::Socket sock (ZMQ_DEALER);
+    sock.connect (endpt);
+    zmqcpp::Message ready;
+    ready.add_frame (zmqcpp::LoadBalancer::READY);
+    sock.send (ready);
+    zmqcpp::EnvelopeMessage req;
+    zmq_pollitem_t item = {(void *) sock.raw_sock(), 0, ZMQ_POLLIN, 0};
+    if (zmq::poll (&item, 1, 2000) > 0 && sock.recv_into (req))
+        got = true;
+}
+
+TEST (LoadBalancer, WorkerDisconnects)
+{
+    // a long expiry, so the broker only finds out when a send to the departed worker fails
+    zmqcpp::LoadBalancer lb ("tcp://*:5597", "tcp://*:5598", std::chrono::milliseconds (60000));
+    zmqcpp::Socket client (ZMQ_DEALER);
+    client.connect ("tcp://localhost:5597");
+    std::atomic<bool> got (false), done (false);
+    std::thread gone (take_one, "tcp://localhost:5598", std::ref (got));
+    for (int i = 0; i < 200 && lb.workers().size() < 1; i++)
+        lb.serve_once (10);
+    ASSERT_EQ (1, lb.workers().size());
+    zmqcpp::Message req;
+    req.add_frame ("");
+    req.add_frame ("first");
+    client.send (req);
+    for (int i = 0; i < 200 && !got; i++)
+        lb.serve_once (10);
+    gone.join();
+    ASSERT_TRUE (got);
+
+    std::thread live (work, "tcp://localhost:5598", "live", 50, std::ref (done));
+    for (int i = 0; i < 200 && lb.workers().size() < 2; i++)
+        lb.serve_once (10);
+    ASSERT_EQ (2, lb.workers().size());
+    // let the backend see the departed worker's connection close
+    for (int i = 0; i < 20; i++)
+        lb.serve_once (10);
+
+    // with its one request outstanding, the departed worker is picked as soon as the live one has two
+    for (int i = 0; i < 4; i++)
+    {
+        zmqcpp::Message r;
+        r.add_frame ("");
+        r.add_frame (std::to_string (i));
+        client.send (r);
+    }
+    int answered = 0;
+    zmqcpp::Message rep;
+    for (int i = 0; i < 500 && answered < 4; i++)
+    {
+        lb.serve_once (10);
+        while (client.recv_into (rep, ZMQ_DONTWAIT))
+        {
+            EXPECT_EQ ("live", rep.last());
+            answered++;
+        }
+    }
+    done = true;
+    live.join();
+    // every request was retried on the live worker; only the one the departed worker took is lost
+    EXPECT_EQ (4, answered);
+    EXPECT_EQ (1, lb.workers().size());
+    EXPECT_EQ (1, lb.stats().lost);
+    EXPECT_EQ (0, lb.stats().unrouted);
+    EXPECT_EQ (5, lb.stats().requests);
+    EXPECT_EQ (4, lb.stats().replies);
+}
+
+// a worker with a fixed two-byte identity that counts the requests it is given
+static void keyed_worker (const int n, std::atomic<int> &hits, std::atomic<bool> &done)
+{
+    zmqcpp::Socket sock (ZMQ_DEALER);
+    const std::array<char, 2> id = {{'w', static_cast<char> ('0' + n)}};
+    sock.setsockopt (ZMQ_IDENTITY, id);
+    sock.connect ("tcp://localhost:5590");
+    zmqcpp::Message ready;
+    ready.add_frame (zmqcpp::LoadBalancer::READY);
+    sock.send (ready);
+    zmqcpp::EnvelopeMessage req;
+    while (!done)
+    {
+        zmq_pollitem_t item = {(void *) sock.raw_sock(), 0, ZMQ_POLLIN, 0};
+        if (zmq::poll (&item, 1, 10) > 0 && sock.recv_into (req))
+            hits++;
+    }
+}
+
+TEST (AffinityRouter, Rendezvous)
+{
+    zmqcpp::AffinityRouter router ("tcp://*:5589", "tcp://*:5590", 0, std::chrono::milliseconds (60000));
+    std::atomic<bool> done (false);
+    std::atomic<int> hits[3];
+    std::vector<std::thread> workers;
+    for (int n = 0; n < 2; n++)
+    {
+        hits[n] = 0;
+        workers.emplace_back (keyed_worker, n, std::ref (hits[n]), std::ref (done));
+    }
+    for (int i = 0; i < 200 && router.workers().size() < 2; i++)
+        router.serve_once (10);
+    ASSERT_EQ (2, router.workers().size());
+
+    std::vector<std::string> before;
+    for (int k = 0; k < 200; k++)
+        before.push_back (router.owner ("key" + std::to_string (k)));
+
+    // a new worker only takes keys over; nothing moves between the old ones
+    hits[2] = 0;
+    workers.emplace_back (keyed_worker, 2, std::ref (hits[2]), std::ref (done));
+    for (int i = 0; i < 200 && router.workers().size() < 3; i++)
+        router.serve_once (10);
+    ASSERT_EQ (3, router.workers().size());
+    int moved = 0;
+    for (int k = 0; k < 200; k++)
+    {
+        const std::string now = router.owner ("key" + std::to_string (k));
+        if (now != before[k])
+        {
+            EXPECT_EQ ("w2", now);
+            moved++;
+        }
+    }
+    EXPECT_LT (30, moved);
+    EXPECT_GT (110, moved);
+
+    // requests go to their key's owner, every time
+    zmqcpp::Socket client (ZMQ_DEALER);
+    client.connect ("tcp://localhost:5589");
+    for (int i = 0; i < 5; i++)
+    {
+        zmqcpp::Message req;
+        req.add_frame ("");
+        req.add_frame ("key7");
+        client.send (req);
+    }
+    const int owner = router.owner ("key7")[1] - '0';
+    for (int i = 0; i < 200 && hits[owner] < 5; i++)
+        router.serve_once (10);
+    done = true;
+    for (std::thread &t : workers)
+        t.join();
+    for (int n = 0; n < 3; n++)
+        EXPECT_EQ (n == owner ? 5 : 0, hits[n]);
+    EXPECT_EQ (5, router.sticky());
+}
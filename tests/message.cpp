@@ -22,12 +22,21 @@
  */
 
 #include "../zmqcpp.h"
+#include "../messages/envelope.h"
+#include "../messages/typed_message.h"
 #include "gtest/gtest.h"
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
 #include <string>
 #include <zmq.hpp>
 
 const char BIND[] = "tcp://*:5557";
 const char CONN[] = "tcp://localhost:5557";
+const char BIND2[] = "tcp://*:5576";
+const char CONN2[] = "tcp://localhost:5576";
+const char BIND3[] = "tcp://*:5577";
+const char CONN3[] = "tcp://localhost:5577";
 
 TEST (MessageTest, Send)
 {
@@ -82,3 +91,153 @@ TEST (MessageTest, MultiPart)
     ASSERT_EQ (DATA2, recvd.last());
 }
 
+
+TEST (MessageTest, RecvIntoReusesFrames)
+{
+    zmqcpp::Socket send (ZMQ_PUSH);
+    zmqcpp::Socket recv (ZMQ_PULL);
+    send.bind (BIND);
+    recv.connect (CONN);
+    zmqcpp::Message mesg, recvd;
+    mesg.add_frame ("a frame long enough to live on the heap");
+    mesg.add_frame ("and another one");
+    ASSERT_TRUE (send.send (mesg));
+    ASSERT_TRUE (recv.recv_into (recvd));
+    ASSERT_EQ (2, recvd.frames().size());
+    const std::string *slot = recvd.frames().front().get();
+    zmqcpp::Message single ("short");
+    ASSERT_TRUE (send.send (single));
+    ASSERT_TRUE (recv.recv_into (recvd));
+    // replaced, not appended, and the first frame's string was reused
+    ASSERT_EQ (1, recvd.frames().size());
+    ASSERT_EQ ("short", recvd.last());
+    ASSERT_EQ (slot, recvd.frames().front().get());
+    ASSERT_TRUE (send.send (mesg));
+    ASSERT_TRUE (recv.recv_into (recvd));
+    ASSERT_EQ ("a frame long enough to live on the heap", recvd.first());
+    ASSERT_EQ ("and another one", recvd.last());
+}
+
+TEST (MessageTest, FileFrame)
+{
+    zmqcpp::Socket send (ZMQ_PUSH);
+    zmqcpp::Socket recv (ZMQ_PULL);
+    send.bind (BIND);
+    recv.connect (CONN);
+    const char PATH[] = "zmqcpp_file_frame_test";
+    std::string contents;
+    for (int i = 0; i < 10000; i++)
+        contents.push_back ('0' + i % 10);
+    std::ofstream (PATH, std::ios::binary) << contents;
+    zmqcpp::Message mesg, recvd;
+    mesg.add_frame ("blob");
+    // ranges past the end of the file are refused rather than mapped
+    ASSERT_THROW (zmqcpp::map_file_frame (PATH, 9000, 2000), std::runtime_error);
+    ASSERT_THROW (zmqcpp::map_file_frame (PATH, 20000), std::runtime_error);
+    mesg.add_file_frame (PATH, 5000, 4000);
+    zmqcpp::const_buffer view = zmqcpp::frame_view (mesg.frames().back());
+    ASSERT_EQ (4000, view.size);
+    ASSERT_TRUE (send.send (mesg));
+    mesg.clear();
+    remove (PATH);
+    ASSERT_TRUE (recv.recv_into (recvd));
+    ASSERT_EQ ("blob", recvd.first());
+    ASSERT_EQ (contents.substr (5000, 4000), recvd.last());
+}
+
+TEST (MessageTest, TypedMessage)
+{
+    zmqcpp::Socket send (ZMQ_PUSH);
+    zmqcpp::Socket recv (ZMQ_PULL);
+    send.bind (BIND2);
+    recv.connect (CONN2);
+    recv._conn();
+    typedef zmqcpp::TypedMessage<std::string, uint64_t, double> msg_t;
+    msg_t out ("quote", 42, 1.5);
+    ASSERT_EQ (sizeof (uint64_t), out.raw<1>().size());
+    ASSERT_TRUE (out.send (send));
+    msg_t in;
+    ASSERT_TRUE (in.recv (recv));
+    ASSERT_EQ ("quote", in.get<0>());
+    ASSERT_EQ (42, in.get<1>());
+    ASSERT_EQ (1.5, in.get<2>());
+    // a message of the wrong shape is read whole and rejected
+    zmqcpp::Message wrong;
+    wrong.add_frame ("quote");
+    wrong.add_frame ("short");
+    ASSERT_TRUE (send.send (wrong));
+    ASSERT_TRUE (out.send (send));
+    ASSERT_FALSE (in.recv (recv));
+    ASSERT_TRUE (in.recv (recv));
+    ASSERT_EQ (42, in.get<1>());
+    // frames that don't decode as their declared type throw
+    zmqcpp::TypedMessage<std::string, uint64_t> bad;
+    wrong.add_frame ("x");
+    send.send (wrong);
+    ASSERT_FALSE (bad.recv (recv));
+    zmqcpp::Message two;
+    two.add_frame ("a");
+    two.add_frame ("abc");
+    send.send (two);
+    ASSERT_TRUE (bad.recv (recv));
+    ASSERT_THROW (bad.get<1>(), zmqcpp::codec_error);
+}
+
+TEST (MessageTest, Header)
+{
+    typedef zmqcpp::Header<zmqcpp::field<uint8_t>, zmqcpp::field<uint16_t, 2, zmqcpp::LSB_FIRST>,
+            zmqcpp::field<int64_t, 6>> hdr_t;
+    ASSERT_EQ (9, hdr_t::SIZE);
+    const hdr_t h (3, 0x0102, -5);
+    const std::string bytes = h.encode();
+    ASSERT_EQ (std::string ("\x03\x02\x01\xff\xff\xff\xff\xff\xfb", 9), bytes);
+    hdr_t back;
+    ASSERT_TRUE (back.decode (bytes.data(), bytes.size()));
+    ASSERT_EQ (3, back.get<0>());
+    ASSERT_EQ (0x0102, back.get<1>());
+    ASSERT_EQ (-5, back.get<2>());
+    ASSERT_FALSE (back.decode (bytes.data(), 8));
+    // headers are frames like any other
+    zmqcpp::Message mesg;
+    mesg.add_frame (h);
+    mesg.add_frame ("body");
+    hdr_t first;
+    ASSERT_TRUE (first.decode (mesg.frames().front()));
+    ASSERT_EQ (-5, first.get<2>());
+    // and a TypedMessage frame type
+    zmqcpp::TypedMessage<hdr_t, std::string> typed (h, "body");
+    ASSERT_EQ (bytes, typed.raw<0>());
+}
+
+TEST (MessageTest, Envelope)
+{
+    zmqcpp::Socket server (ZMQ_ROUTER);
+    zmqcpp::Socket client (ZMQ_REQ);
+    server.bind (BIND3);
+    client.connect (CONN3);
+    ASSERT_TRUE (client.send (zmqcpp::Message ("hello")));
+    // [identity][""][hello]: the first two are routing frames, kept out of the body
+    zmqcpp::EnvelopeMessage req;
+    ASSERT_TRUE (server.recv_into (req));
+    ASSERT_EQ (2, req.hops());
+    ASSERT_EQ (0, req.hop_view (1).size);
+    ASSERT_EQ (1, req.frames().size());
+    ASSERT_EQ ("hello", req.first());
+    // the reply borrows the request's envelope
+    zmqcpp::EnvelopeMessage rep;
+    rep.copy_envelope (req);
+    rep.add_frame ("world");
+    ASSERT_TRUE (server.send (rep));
+    zmqcpp::Message answer;
+    ASSERT_TRUE (client.recv (answer));
+    ASSERT_EQ (1, answer.frames().size());
+    ASSERT_EQ ("world", answer.first());
+    // hops push and pop on the outside of the envelope
+    rep.push_hop ("worker-1");
+    ASSERT_EQ (3, rep.hops());
+    ASSERT_EQ ("worker-1", std::string (static_cast<const char *> (rep.hop_view (0).data), rep.hop_view (0).size));
+    rep.pop_hop();
+    ASSERT_EQ (2, rep.hops());
+    ASSERT_EQ (req.hop_view (0).size, rep.hop_view (0).size);
+    ASSERT_EQ (0, memcmp (req.hop_view (0).data, rep.hop_view (0).data, rep.hop_view (0).size));
+}
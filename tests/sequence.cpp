@@ -0,0 +1,93 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file sequence.cpp
+ * \author Nathan Eloe
+ * \brief tests sequence stamping and gap tracking
+ */
+
+#include "../zmqcpp.h"
+#include "../patterns/sequence.h"
+#include "gtest/gtest.h"
+#include <string>
+
+static zmqcpp::seq_event feed (zmqcpp::SeqTracker &tracker, const std::string &topic, const uint64_t n,
+                               const zmqcpp::seq_scope scope = zmqcpp::SEQ_PER_PUBLISHER)
+{
+    const std::string seq = zmqcpp::seq_header (7, scope, n).encode();
+    return tracker.track (zmqcpp::buffer (topic), zmqcpp::buffer (seq));
+}
+
+TEST (Sequence, Tracker)
+{
+    uint64_t gap_first = 0, gap_count = 0;
+    zmqcpp::SeqTracker tracker ([&] (uint32_t id, const std::string & topic, uint64_t first, uint64_t count)
+    {
+        EXPECT_EQ (7, id);
+        EXPECT_EQ ("", topic);
+        gap_first = first;
+        gap_count = count;
+    });
+    EXPECT_EQ (zmqcpp::SEQ_IN_ORDER, feed (tracker, "a", 10));
+    EXPECT_EQ (zmqcpp::SEQ_IN_ORDER, feed (tracker, "b", 11));
+    EXPECT_EQ (zmqcpp::SEQ_GAP, feed (tracker, "a", 15));
+    EXPECT_EQ (12, gap_first);
+    EXPECT_EQ (3, gap_count);
+    EXPECT_EQ (zmqcpp::SEQ_LATE, feed (tracker, "a", 13));
+    EXPECT_EQ (zmqcpp::SEQ_DUPLICATE, feed (tracker, "a", 13));
+    EXPECT_EQ (zmqcpp::SEQ_DUPLICATE, feed (tracker, "a", 15));
+    // older than the first message seen
+    EXPECT_EQ (zmqcpp::SEQ_DUPLICATE, feed (tracker, "a", 9));
+    EXPECT_EQ (zmqcpp::SEQ_IN_ORDER, feed (tracker, "a", 16));
+
+    const zmqcpp::seq_stats &st = tracker.stats();
+    EXPECT_EQ (8, st.received);
+    EXPECT_EQ (1, st.gaps);
+    EXPECT_EQ (2, st.missing);
+    EXPECT_EQ (3, st.duplicates);
+    EXPECT_EQ (1, st.late);
+
+    // per-topic streams are numbered separately
+    EXPECT_EQ (zmqcpp::SEQ_IN_ORDER, feed (tracker, "x", 0, zmqcpp::SEQ_PER_TOPIC));
+    EXPECT_EQ (zmqcpp::SEQ_IN_ORDER, feed (tracker, "y", 0, zmqcpp::SEQ_PER_TOPIC));
+    EXPECT_EQ (zmqcpp::SEQ_IN_ORDER, feed (tracker, "x", 1, zmqcpp::SEQ_PER_TOPIC));
+
+    EXPECT_EQ (zmqcpp::SEQ_UNSEQUENCED, tracker.track (zmqcpp::buffer ("a", 1), zmqcpp::buffer ("short", 5)));
+    EXPECT_EQ (1, st.unsequenced);
+}
+
+TEST (Sequence, OverSocket)
+{
+    zmqcpp::Socket push (ZMQ_PUSH), pull (ZMQ_PULL);
+    push.bind ("tcp://*:5583");
+    pull.connect ("tcp://localhost:5583");
+    zmqcpp::SeqPublisher seq (push, zmqcpp::SEQ_PER_TOPIC);
+    zmqcpp::SeqTracker tracker;
+    zmqcpp::Message body, got;
+    body.add_frame ("payload");
+    for (int i = 0; i < 3; i++)
+        ASSERT_TRUE (seq.send (i == 1 ? "t2" : "t1", body));
+    for (int i = 0; i < 3; i++)
+    {
+        ASSERT_TRUE (pull.recv_into (got));
+        EXPECT_EQ (zmqcpp::SEQ_IN_ORDER, tracker.track (got));
+        EXPECT_EQ ("payload", got.last());
+    }
+    EXPECT_EQ (3, tracker.stats().received);
+    EXPECT_EQ (0, tracker.stats().gaps);
+}
@@ -0,0 +1,160 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file shm.cpp
+ * \author Nathan Eloe
+ * \brief tests the shared memory side channel
+ */
+
+#include "../zmqcpp.h"
+#include "gtest/gtest.h"
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <zmq.hpp>
+
+TEST (ShmTest, RingPutAndRelease)
+{
+    zmqcpp::ShmRing ring (4096);
+    zmqcpp::shm_desc d1, d2;
+    const std::string DATA (3000, 'q');
+    ASSERT_TRUE (ring.put (DATA.data(), DATA.size(), d1));
+    // no room for a second one until the first is released
+    ASSERT_FALSE (ring.put (DATA.data(), DATA.size(), d2));
+    {
+        std::shared_ptr<std::string> f = zmqcpp::ShmRing::open (&d1);
+        ASSERT_EQ (DATA.size(), zmqcpp::frame_view (f).size);
+    }
+    ASSERT_TRUE (ring.put (DATA.data(), DATA.size(), d2));
+    // d1's record has been reused, so d1 is stale now
+    ASSERT_THROW (zmqcpp::ShmRing::open (&d1), std::runtime_error);
+}
+
+TEST (ShmTest, SendRecvThroughRing)
+{
+    zmqcpp::Socket send (ZMQ_PUSH);
+    zmqcpp::Socket recv (ZMQ_PULL);
+    send.bind ("ipc://zmqcpp-shm-test.ipc");
+    recv.connect ("ipc://zmqcpp-shm-test.ipc");
+    recv._conn();
+    // room for two payloads at a time, so the ring only keeps up if records get released
+    send.use_shm (1024, 256 * 1024);
+    recv.use_shm();
+    zmqcpp::Message mesg, recvd;
+    mesg.add_frame ("hdr");
+    mesg.add_frame (std::string (100 * 1024, 'z'));
+    for (int i = 0; i < 20; i++)
+    {
+        ASSERT_TRUE (send.send (mesg));
+        ASSERT_TRUE (recv.recv_into (recvd));
+        ASSERT_EQ ("hdr", recvd.first());
+        // the payload arrived as a mapped region, not as a copy in the string
+        ASSERT_TRUE (recvd.frames().back()->empty());
+        ASSERT_EQ (100 * 1024, zmqcpp::frame_view (recvd.frames().back()).size);
+        ASSERT_EQ (* (mesg.frames().back()), recvd.last());
+    }
+}
+
+TEST (ShmTest, StaleDescriptorFailsOneMessage)
+{
+    zmqcpp::ShmRing ring (4096);
+    zmqcpp::shm_desc stale, fresh;
+    const std::string DATA (3000, 'q');
+    ASSERT_TRUE (ring.put (DATA.data(), DATA.size(), stale));
+    zmqcpp::ShmRing::open (&stale);
+    ASSERT_TRUE (ring.put (DATA.data(), DATA.size(), fresh));
+    ASSERT_EQ (nullptr, zmqcpp::ShmRing::try_open (&stale));
+
+    zmqcpp::Socket send (ZMQ_PUSH);
+    zmqcpp::Socket recv (ZMQ_PULL);
+    send.bind ("ipc://zmqcpp-shm-stale.ipc");
+    recv.connect ("ipc://zmqcpp-shm-stale.ipc");
+    recv._conn();
+    recv.use_shm();
+    zmqcpp::Message bad, good, recvd;
+    bad.add_frame ("before");
+    bad.add_frame (reinterpret_cast<const char *> (&stale), sizeof (stale));
+    bad.add_frame ("after");
+    good.add_frame ("next");
+    ASSERT_TRUE (send.send (bad));
+    ASSERT_TRUE (send.send (good));
+    ASSERT_TRUE (send.send (bad));
+    ASSERT_TRUE (send.send (good));
+    // the bad message is read off whole, so the next one starts where it should
+    ASSERT_FALSE (recv.recv_into (recvd));
+    ASSERT_TRUE (recv.recv_into (recvd));
+    ASSERT_EQ (1, recvd.frames().size());
+    ASSERT_EQ ("next", recvd.first());
+    recvd.clear();
+    ASSERT_FALSE (recv.recv (recvd));
+    ASSERT_EQ (0, recvd.frames().size());
+    ASSERT_TRUE (recv.recv (recvd));
+    ASSERT_EQ ("next", recvd.first());
+}
+
+TEST (ShmTest, ClosedRingIsUnmappedAfterItsFrames)
+{
+    zmqcpp::shm_desc d1, d2;
+    std::shared_ptr<std::string> f1;
+    {
+        zmqcpp::ShmRing ring (4096);
+        ASSERT_TRUE (ring.put ("hello", 5, d1));
+        ASSERT_TRUE (ring.put ("again", 5, d2));
+        // a descriptor for an earlier segment of the same name is refused
+        zmqcpp::shm_desc other = d1;
+        other.instance ^= 1;
+        ASSERT_EQ (nullptr, zmqcpp::ShmRing::try_open (&other));
+        f1 = zmqcpp::ShmRing::open (&d1);
+    }
+    // the segment is gone, but the frame keeps its mapping alive
+    zmqcpp::const_buffer v1 = zmqcpp::frame_view (f1);
+    ASSERT_EQ ("hello", std::string (static_cast<const char *> (v1.data), v1.size));
+    // a late descriptor into the closed segment still reads through the existing mapping once...
+    std::shared_ptr<std::string> f2 = zmqcpp::ShmRing::try_open (&d2);
+    ASSERT_NE (nullptr, f2);
+    zmqcpp::const_buffer v2 = zmqcpp::frame_view (f2);
+    ASSERT_EQ ("again", std::string (static_cast<const char *> (v2.data), v2.size));
+    // ...but the cache has let go of it, and the name no longer opens
+    f1.reset();
+    f2.reset();
+    ASSERT_EQ (nullptr, zmqcpp::ShmRing::try_open (&d2));
+}
+
+TEST (ShmTest, UnreleasedRecordExpires)
+{
+    zmqcpp::ShmRing ring (4096, std::chrono::milliseconds (50));
+    zmqcpp::shm_desc lost, next;
+    const std::string DATA (3000, 'q');
+    // nobody ever opens lost, so nobody releases it
+    ASSERT_TRUE (ring.put (DATA.data(), DATA.size(), lost));
+    ASSERT_FALSE (ring.put (DATA.data(), DATA.size(), next));
+    std::this_thread::sleep_for (std::chrono::milliseconds (100));
+    // once its lease is up the sender takes it back, and the late descriptor is stale
+    ASSERT_TRUE (ring.put (DATA.data(), DATA.size(), next));
+    ASSERT_EQ (1, ring.expired());
+    ASSERT_EQ (nullptr, zmqcpp::ShmRing::try_open (&lost));
+    ASSERT_NE (nullptr, zmqcpp::ShmRing::try_open (&next));
+}
+
+TEST (ShmTest, PointToPointOnly)
+{
+    zmqcpp::Socket pub (ZMQ_PUB), push (ZMQ_PUSH);
+    ASSERT_THROW (pub.use_shm(), std::runtime_error);
+    push.use_shm();
+}
@@ -23,7 +23,10 @@
 
 #include "../zmqcpp.h"
 #include "gtest/gtest.h"
+#include <atomic>
+#include <chrono>
 #include <string>
+#include <thread>
 #include <zmq.hpp>
 
 const char BIND[] = "tcp://*:5555";
@@ -32,6 +35,20 @@ const char BIND2[] = "tcp://*:5556";
 const char CONN2[] = "tcp://localhost:5556";
 const char BIND3[] = "tcp://*:5559";
 const char CONN3[] = "tcp://localhost:5559";
+const char BIND4[] = "tcp://*:5560";
+const char CONN4[] = "tcp://localhost:5560";
+const char BIND5[] = "tcp://*:5561";
+const char CONN5[] = "tcp://localhost:5561";
+const char BIND6[] = "tcp://*:5570";
+const char CONN6[] = "tcp://localhost:5570";
+const char BIND7[] = "tcp://*:5572";
+const char CONN7[] = "tcp://localhost:5572";
+
+static std::atomic<int> released (0);
+static void count_release (void *data, void *hint)
+{
+    released++;
+}
 
 /*TEST(SocketTest, CreateFragileAndSend)
 {
@@ -139,3 +156,122 @@ TEST (SocketTest, MultiConn)
     ASSERT_STREQ ("W2", data);
 }
 
+
+TEST (SocketTest, SendvCopy)
+{
+    zmqcpp::Socket send (ZMQ_PUSH);
+    zmqcpp::Socket recv (ZMQ_PULL);
+    send.bind (BIND4);
+    recv.connect (CONN4);
+    recv._conn();
+    std::string hdr = "header", body = "body";
+    std::vector<zmqcpp::const_buffer> bufs = {zmqcpp::buffer (hdr), zmqcpp::buffer (body)};
+    ASSERT_TRUE (send.sendv (bufs));
+    hdr = "clobbered";
+    zmqcpp::Message m;
+    ASSERT_TRUE (recv.recv (m));
+    ASSERT_EQ (2, m.frames().size());
+    ASSERT_EQ ("header", m.first());
+    ASSERT_EQ ("body", m.last());
+}
+
+TEST (SocketTest, SendvBorrowed)
+{
+    zmqcpp::Socket send (ZMQ_PUSH);
+    zmqcpp::Socket recv (ZMQ_PULL);
+    send.bind (BIND5);
+    recv.connect (CONN5);
+    recv._conn();
+    static const char HDR[] = "header";
+    static const char BODY[] = "a much longer body that libzmq will not copy inline";
+    zmqcpp::const_buffer bufs[] = {zmqcpp::buffer (HDR, sizeof (HDR) - 1), zmqcpp::buffer (BODY, sizeof (BODY) - 1)};
+    released = 0;
+    ASSERT_TRUE (send.sendv (bufs, 2, count_release, nullptr));
+    zmqcpp::Message m;
+    ASSERT_TRUE (recv.recv (m));
+    ASSERT_EQ (std::string (HDR), m.first());
+    ASSERT_EQ (std::string (BODY), m.last());
+    for (int i = 0; i < 100 && released < 2; i++)
+        std::this_thread::sleep_for (std::chrono::milliseconds (10));
+    ASSERT_EQ (2, released);
+}
+
+TEST (SocketTest, RecvFrames)
+{
+    zmqcpp::Socket send (ZMQ_PUSH);
+    zmqcpp::Socket recv (ZMQ_PULL);
+    send.bind (BIND6);
+    recv.connect (CONN6);
+    recv._conn();
+    zmqcpp::Message mesg;
+    mesg.add_frame ("route");
+    mesg.add_frame ("body1");
+    mesg.add_frame ("body2");
+    ASSERT_TRUE (send.send (mesg));
+    ASSERT_TRUE (send.send (mesg));
+    ASSERT_TRUE (send.send (zmqcpp::Message ("next")));
+    std::vector<std::string> seen;
+    auto collect = [&seen] (const zmqcpp::const_buffer & f, bool more) -> zmqcpp::frame_act
+    {
+        seen.push_back (std::string (static_cast<const char *> (f.data), f.size));
+        return zmqcpp::FRAME_NEXT;
+    };
+    // look at the envelope only, drop the rest
+    ASSERT_TRUE (recv.recv_frames ([&seen] (const zmqcpp::const_buffer & f, bool more) -> zmqcpp::frame_act
+    {
+        seen.push_back (std::string (static_cast<const char *> (f.data), f.size));
+        return zmqcpp::FRAME_SKIP;
+    }));
+    ASSERT_EQ (1, seen.size());
+    // stop after the first frame; the rest of the message is still queued
+    ASSERT_TRUE (recv.recv_frames ([] (const zmqcpp::const_buffer & f, bool more) -> zmqcpp::frame_act
+    {
+        return more ? zmqcpp::FRAME_STOP : zmqcpp::FRAME_NEXT;
+    }));
+    ASSERT_TRUE (recv.recv_frames (collect));
+    ASSERT_TRUE (recv.recv_frames (collect));
+    std::vector<std::string> expected = {"route", "body1", "body2", "next"};
+    ASSERT_EQ (expected, seen);
+}
+
+TEST (SocketTest, OutboxBackpressure)
+{
+    zmqcpp::Socket send (ZMQ_PUSH);
+    send.bind (BIND7);
+    zmqcpp::Message mesg;
+    mesg.add_frame ("head");
+    mesg.add_frame ("tail");
+    // nobody is connected yet, so libzmq has nowhere to put the message
+    ASSERT_FALSE (send.send (mesg, ZMQ_DONTWAIT));
+    ASSERT_FALSE (send.writable());
+    size_t full_at = 0;
+    send.set_outbox (2, [&full_at] (size_t depth)
+    {
+        full_at = depth;
+    });
+    ASSERT_TRUE (send.send (mesg, ZMQ_DONTWAIT));
+    const std::string one = "one", two = "two";
+    ASSERT_TRUE (send.sendv ({zmqcpp::buffer (one), zmqcpp::buffer (two)}, ZMQ_DONTWAIT));
+    ASSERT_FALSE (send.send (mesg, ZMQ_DONTWAIT));
+    ASSERT_EQ (2, full_at);
+    ASSERT_EQ (2, send.outbox_depth());
+    ASSERT_EQ (2, send.stats().queued);
+    ASSERT_EQ (1, send.stats().rejected);
+
+    zmqcpp::Socket recv (ZMQ_PULL);
+    recv.connect (CONN7);
+    recv._conn();
+    for (int i = 0; i < 100 && send.flush(); i++)
+        std::this_thread::sleep_for (std::chrono::milliseconds (10));
+    ASSERT_EQ (0, send.outbox_depth());
+    ASSERT_EQ (2, send.stats().sent);
+    // both messages arrive whole and in order
+    zmqcpp::Message recvd;
+    ASSERT_TRUE (recv.recv_into (recvd));
+    ASSERT_EQ (2, recvd.frames().size());
+    ASSERT_EQ ("head", recvd.first());
+    ASSERT_TRUE (recv.recv_into (recvd));
+    ASSERT_EQ (2, recvd.frames().size());
+    ASSERT_EQ ("one", recvd.first());
+    ASSERT_EQ ("two", recvd.last());
+}
@@ -0,0 +1,75 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file stream.cpp
+ * \author Nathan Eloe
+ * \brief tests chunked, credit-based streaming
+ */
+
+#include "../zmqcpp.h"
+#include "../patterns/stream.h"
+#include "gtest/gtest.h"
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+
+// a file a bit over 9 chunks long, so the last chunk is a short one
+static std::string make_file (const std::string &path)
+{
+    std::string data;
+    for (int i = 0; i < 9 * 4096 + 123; i++)
+        data.push_back ('a' + (i * 7) % 26);
+    std::ofstream (path.c_str(), std::ios::binary) << data;
+    return data;
+}
+
+static void transfer (const char *bind, const char *conn, const zmqcpp::StreamSender::io_mode mode)
+{
+    const std::string path = std::string ("zmqcpp_stream_test_") + (mode == zmqcpp::StreamSender::MMAP ? "mmap" : "pread");
+    const std::string data = make_file (path);
+    std::atomic<bool> done (false);
+    std::thread server ([&]()
+    {
+        zmqcpp::StreamSender sender (bind, path, 4096, mode);
+        while (!done)
+            sender.serve_once (10);
+    });
+    zmqcpp::StreamReceiver recv (conn, 3);
+    std::string got;
+    char buf[1000];
+    size_t n;
+    while ((n = recv.read (buf, sizeof (buf))))
+        got.append (buf, n);
+    done = true;
+    server.join();
+    remove (path.c_str());
+    ASSERT_TRUE (recv.done());
+    ASSERT_EQ (data, got);
+}
+
+TEST (StreamTest, Pread)
+{
+    transfer ("tcp://*:5568", "tcp://localhost:5568", zmqcpp::StreamSender::PREAD);
+}
+
+TEST (StreamTest, Mmap)
+{
+    transfer ("tcp://*:5569", "tcp://localhost:5569", zmqcpp::StreamSender::MMAP);
+}
@@ -0,0 +1,166 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file subscriber.cpp
+ * \author Nathan Eloe
+ * \brief tests the prefix trie, the prefix-dispatching subscriber and the subscription-aware publisher
+ */
+
+#include "../zmqcpp.h"
+#include "../patterns/publisher.h"
+#include "../patterns/subscriber.h"
+#include "gtest/gtest.h"
+#include <chrono>
+#include <string>
+#include <thread>
+
+TEST (PrefixTrie, LongestMatch)
+{
+    zmqcpp::PrefixTrie<int> trie;
+    EXPECT_TRUE (trie.insert ("abcd", 1));
+    // splits the "abcd" edge twice
+    EXPECT_TRUE (trie.insert ("ab", 2));
+    EXPECT_TRUE (trie.insert ("abx", 3));
+    EXPECT_FALSE (trie.insert ("ab", 4));
+    EXPECT_EQ (3, trie.size());
+
+    ASSERT_NE (nullptr, trie.find ("abcd"));
+    EXPECT_EQ (1, *trie.find ("abcd"));
+    EXPECT_EQ (4, *trie.find ("ab"));
+    EXPECT_EQ (nullptr, trie.find ("abc"));
+    EXPECT_EQ (nullptr, trie.find ("a"));
+
+    EXPECT_EQ (1, *trie.longest_match ("abcdef"));
+    EXPECT_EQ (4, *trie.longest_match ("abc"));
+    EXPECT_EQ (3, *trie.longest_match ("abxyz"));
+    EXPECT_EQ (nullptr, trie.longest_match ("a"));
+    EXPECT_EQ (nullptr, trie.longest_match ("zzz"));
+
+    EXPECT_TRUE (trie.erase ("ab"));
+    EXPECT_FALSE (trie.erase ("ab"));
+    EXPECT_FALSE (trie.erase ("q"));
+    EXPECT_EQ (nullptr, trie.longest_match ("abc"));
+    EXPECT_EQ (1, *trie.longest_match ("abcd"));
+    EXPECT_EQ (2, trie.size());
+
+    // the empty key matches everything
+    trie.insert ("", 9);
+    EXPECT_EQ (9, *trie.longest_match ("zzz"));
+    EXPECT_EQ (9, *trie.longest_match (""));
+}
+
+TEST (Subscriber, Dispatch)
+{
+    zmqcpp::Socket pub (ZMQ_PUB);
+    pub.bind ("tcp://*:5578");
+    zmqcpp::Subscriber sub ("tcp://localhost:5578");
+    std::string a, ab;
+    sub.on ("a", [&a] (zmqcpp::Message & m)
+    {
+        a = m.last();
+    });
+    sub.on ("ab", [&ab] (zmqcpp::Message & m)
+    {
+        ab = m.last();
+    });
+    EXPECT_EQ (2, sub.handlers());
+
+    // the subscriptions take a moment to reach the publisher
+    for (int i = 0; i < 100 && ab.empty(); i++)
+    {
+        zmqcpp::Message m;
+        m.add_frame ("abc");
+        m.add_frame ("long");
+        pub.send (m);
+        sub.dispatch (10);
+    }
+    EXPECT_EQ ("long", ab);
+    EXPECT_EQ ("", a);
+
+    for (int i = 0; i < 100 && a.empty(); i++)
+    {
+        zmqcpp::Message m;
+        m.add_frame ("ax");
+        m.add_frame ("short");
+        pub.send (m);
+        sub.dispatch (10);
+    }
+    EXPECT_EQ ("short", a);
+
+    EXPECT_TRUE (sub.off ("ab"));
+    EXPECT_FALSE (sub.off ("ab"));
+    a.clear();
+    for (int i = 0; i < 100 && a.empty(); i++)
+    {
+        zmqcpp::Message m;
+        m.add_frame ("abc");
+        m.add_frame ("fallback");
+        pub.send (m);
+        sub.dispatch (10);
+    }
+    EXPECT_EQ ("fallback", a);
+    EXPECT_EQ (0, sub.unmatched());
+}
+
+TEST (Publisher, SkipsUnwantedTopics)
+{
+    zmqcpp::Publisher pub ("tcp://*:5579");
+    // the first update binds the socket
+    pub.update();
+    zmqcpp::Socket sub (ZMQ_SUB);
+    sub.connect ("tcp://localhost:5579");
+    sub._conn();
+    sub.raw_sock().setsockopt (ZMQ_SUBSCRIBE, "x.", 2);
+
+    for (int i = 0; i < 100 && !pub.subscriptions(); i++)
+    {
+        std::this_thread::sleep_for (std::chrono::milliseconds (10));
+        pub.update();
+    }
+    ASSERT_EQ (1, pub.subscriptions());
+    EXPECT_TRUE (pub.wanted ("x.1"));
+    EXPECT_FALSE (pub.wanted ("y.1"));
+
+    int built = 0;
+    auto produce = [&built] (zmqcpp::Message & m)
+    {
+        built++;
+        m.add_frame ("body");
+    };
+    EXPECT_FALSE (pub.publish ("y.1", produce));
+    EXPECT_EQ (0, built);
+    EXPECT_EQ (1, pub.skipped());
+    EXPECT_TRUE (pub.publish ("x.1", produce));
+    EXPECT_EQ (1, built);
+    EXPECT_EQ (1, pub.published());
+
+    zmqcpp::Message got;
+    ASSERT_TRUE (sub.recv (got));
+    EXPECT_EQ ("x.1", got.first());
+    EXPECT_EQ ("body", got.last());
+
+    sub.raw_sock().setsockopt (ZMQ_UNSUBSCRIBE, "x.", 2);
+    for (int i = 0; i < 100 && pub.subscriptions(); i++)
+    {
+        std::this_thread::sleep_for (std::chrono::milliseconds (10));
+        pub.update();
+    }
+    EXPECT_EQ (0, pub.subscriptions());
+    EXPECT_FALSE (pub.publish ("x.1", produce));
+    EXPECT_EQ (1, built);
+}
@@ -0,0 +1,79 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file typed_socket.cpp
+ * \author Nathan Eloe
+ * \brief tests the compile-time typed socket layer
+ */
+
+#include "../zmqcpp.h"
+#include "../typed_socket.h"
+#include "gtest/gtest.h"
+#include <chrono>
+#include <string>
+#include <thread>
+#include <zmq.hpp>
+
+TEST (TypedSocketTest, PushPullMultiPart)
+{
+    zmqcpp::TypedSocket<ZMQ_PUSH, zmqcpp::bind_mode> send ("tcp://*:5573");
+    zmqcpp::TypedSocket<ZMQ_PULL> recv ("tcp://localhost:5573");
+    zmqcpp::Message mesg, recvd;
+    mesg.add_frame ("route");
+    mesg.add_frame ("body");
+    ASSERT_TRUE (send.send (mesg));
+    ASSERT_TRUE (recv.recv_into (recvd));
+    ASSERT_EQ (2, recvd.frames().size());
+    ASSERT_EQ ("body", recvd.last());
+    // the dynamic socket underneath is the same one
+    ASSERT_EQ ("tcp://localhost:5573", recv.socket().endpt());
+}
+
+TEST (TypedSocketTest, SinglePart)
+{
+    zmqcpp::TypedSocket<ZMQ_PUSH, zmqcpp::bind_mode, zmqcpp::single_part> send ("tcp://*:5574");
+    zmqcpp::TypedSocket<ZMQ_PULL, zmqcpp::connect_mode, zmqcpp::single_part> recv ("tcp://localhost:5574");
+    zmqcpp::Message recvd;
+    for (int i = 0; i < 10; i++)
+    {
+        ASSERT_TRUE (send.send (zmqcpp::Message (i)));
+        ASSERT_TRUE (recv.recv_into (recvd));
+        ASSERT_EQ (1, recvd.frames().size());
+        ASSERT_EQ (std::to_string (i), recvd.first());
+    }
+}
+
+TEST (TypedSocketTest, PubSub)
+{
+    zmqcpp::TypedSocket<ZMQ_PUB, zmqcpp::bind_mode> pub ("tcp://*:5575");
+    zmqcpp::TypedSocket<ZMQ_SUB> sub ("tcp://localhost:5575");
+    sub.subscribe ("a");
+    zmqcpp::Message recvd;
+    // the subscription takes a moment to reach the publisher
+    bool got = false;
+    for (int i = 0; i < 100 && !got; i++)
+    {
+        pub.send (zmqcpp::Message ("b-skip"));
+        pub.send (zmqcpp::Message ("a-keep"));
+        got = sub.recv_into (recvd, ZMQ_DONTWAIT);
+        if (!got)
+            std::this_thread::sleep_for (std::chrono::milliseconds (10));
+    }
+    ASSERT_TRUE (got);
+    ASSERT_EQ ("a-keep", recvd.last());
+}
@@ -0,0 +1,115 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file zmqreplay.cpp
+ * \author Nathan Eloe
+ * \brief Re-injects a capture log into an endpoint
+ *
+ * usage: zmqreplay <log> <endpoint> [options]
+ *   --type push|pub|dealer|req|pair   socket to send from (default push)
+ *   --bind                            bind to the endpoint instead of connecting
+ *   --speed N                         1 replays at the captured pace, N at N times that, 0 as fast as possible
+ *   --id N                            only replay records captured from socket id N
+ *   --inbound                         replay the received messages instead of the sent ones
+ */
+
+#include "../zmqcpp.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <thread>
+
+namespace
+{
+    int usage (const char *prog)
+    {
+        std::cerr << "usage: " << prog << " <log> <endpoint> [--type push|pub|dealer|req|pair] [--bind]"
+                  << " [--speed N] [--id N] [--inbound]" << std::endl;
+        return 2;
+    }
+}
+
+int main (int argc, char **argv)
+{
+    const std::map<std::string, int> types = {{"push", ZMQ_PUSH}, {"pub", ZMQ_PUB}, {"dealer", ZMQ_DEALER},
+        {"req", ZMQ_REQ}, {"pair", ZMQ_PAIR}
+    };
+    if (argc < 3)
+        return usage (argv[0]);
+    int type = ZMQ_PUSH;
+    bool bind = false, only_id = false;
+    double speed = 1;
+    uint32_t id = 0;
+    zmqcpp::direction dir = zmqcpp::OUTBOUND;
+    for (int i = 3; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--type" && i + 1 < argc && types.count (argv[i + 1]))
+            type = types.at (argv[++i]);
+        else if (arg == "--bind")
+            bind = true;
+        else if (arg == "--speed" && i + 1 < argc)
+            speed = atof (argv[++i]);
+        else if (arg == "--id" && i + 1 < argc)
+        {
+            only_id = true;
+            id = strtoul (argv[++i], nullptr, 10);
+        }
+        else if (arg == "--inbound")
+            dir = zmqcpp::INBOUND;
+        else
+            return usage (argv[0]);
+    }
+
+    zmqcpp::CaptureReader log (argv[1]);
+    zmqcpp::Socket sock (type);
+    if (bind)
+        sock.bind (argv[2]);
+    else
+        sock.connect (argv[2]);
+
+    zmqcpp::capture_record rec;
+    uint64_t first_ts = 0;
+    size_t sent = 0;
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    while (log.next (rec))
+    {
+        if (rec.dir != dir || (only_id && rec.sock_id != id) || rec.frames.empty())
+            continue;
+        if (!first_ts)
+            first_ts = rec.ts_ns;
+        // keep each record's offset from the first one, scaled by the speed; records written by racing
+        // threads can be slightly out of order, and those just go out right away
+        const uint64_t offset = (rec.ts_ns > first_ts) ? rec.ts_ns - first_ts : 0;
+        if (speed > 0)
+            std::this_thread::sleep_until (start + std::chrono::nanoseconds (static_cast<uint64_t> (offset / speed)));
+        if (!sock.sendv (rec.frames))
+        {
+            std::cerr << "send failed after " << sent << " messages" << std::endl;
+            return 1;
+        }
+        sent++;
+        // a REQ socket can't send again until it has its answer
+        if (type == ZMQ_REQ)
+            sock.recv_frames ([] (const zmqcpp::const_buffer &, bool) -> zmqcpp::frame_act { return zmqcpp::FRAME_SKIP; });
+    }
+    std::cout << "replayed " << sent << " messages" << std::endl;
+    return 0;
+}
@@ -0,0 +1,250 @@
+/*
+  Copyright (c) Nathan Eloe, 2014
+  This file is part of EasyZMQ-Cpp.
+
+  EasyZMQ-Cpp is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  EasyZMQ-Cpp is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with EasyZMQ-Cpp.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*!
+ * \file typed_socket.h
+ * \author Nathan Eloe
+ * \brief A socket whose type, connect/bind mode and frame shape are fixed at compile time
+ *
+ * TypedSocket<ZMQ_PUSH> won't compile a recv(), a bind_mode socket never looks at its connection list,
+ * and a single_part socket reads one frame per message without asking libzmq about more.  Socket stays
+ * the dynamic fallback, and socket() hands it out for everything TypedSocket doesn't wrap.
+ */
+
+#pragma once
+
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "socket.h"
+
+namespace zmqcpp
+{
+    struct connect_mode {};
+    struct bind_mode {};
+
+    struct multi_part {};
+    struct single_part {};
+
+    /*!
+     * \brief What each socket type is allowed to do
+     */
+    template <int Type> struct socket_traits;
+    template <> struct socket_traits<ZMQ_PAIR>
+    {
+        static const bool can_send = true, can_recv = true;
+    };
+    template <> struct socket_traits<ZMQ_PUB>
+    {
+        static const bool can_send = true, can_recv = false;
+    };
+    template <> struct socket_traits<ZMQ_SUB>
+    {
+        static const bool can_send = false, can_recv = true;
+    };
+    template <> struct socket_traits<ZMQ_REQ>
+    {
+        static const bool can_send = true, can_recv = true;
+    };
+    template <> struct socket_traits<ZMQ_REP>
+    {
+        static const bool can_send = true, can_recv = true;
+    };
+    template <> struct socket_traits<ZMQ_DEALER>
+    {
+        static const bool can_send = true, can_recv = true;
+    };
+    template <> struct socket_traits<ZMQ_ROUTER>
+    {
+        static const bool can_send = true, can_recv = true;
+    };
+    template <> struct socket_traits<ZMQ_PULL>
+    {
+        static const bool can_send = false, can_recv = true;
+    };
+    template <> struct socket_traits<ZMQ_PUSH>
+    {
+        static const bool can_send = true, can_recv = false;
+    };
+    template <> struct socket_traits<ZMQ_XPUB>
+    {
+        static const bool can_send = true, can_recv = true;
+    };
+    template <> struct socket_traits<ZMQ_XSUB>
+    {
+        static const bool can_send = true, can_recv = true;
+    };
+
+    template <int Type, class Mode = connect_mode, class Parts = multi_part>
+    class TypedSocket
+    {
+      private:
+        static const bool MULTI = std::is_same<Parts, multi_part>::value;
+        Socket m_sock;
+
+        void add (const std::string &endpt, connect_mode)
+        {
+            m_sock.connect (endpt);
+        }
+        void add (const std::string &endpt, bind_mode)
+        {
+            m_sock.bind (endpt);
+        }
+        void open (connect_mode)
+        {
+            m_sock._conn();
+        }
+        void open (bind_mode)
+        {
+            m_sock._bind();
+        }
+        static_assert (std::is_same<Mode, connect_mode>::value || std::is_same<Mode, bind_mode>::value,
+                       "Mode must be connect_mode or bind_mode");
+        static_assert (MULTI || std::is_same<Parts, single_part>::value, "Parts must be multi_part or single_part");
+
+      public:
+        /*!
+         * \brief Constructor
+         * \pre None
+         * \post The socket is constructed with no endpoints
+         */
+        TypedSocket(): m_sock (Type) {}
+        /*!
+         * \brief Constructor
+         * \pre None
+         * \post The socket is constructed and will connect or bind (per Mode) to endpt
+         */
+        TypedSocket (const std::string &endpt): m_sock (Type)
+        {
+            add (endpt);
+        }
+
+        /*!
+         * \brief adds an endpoint; connect_mode sockets connect to it, bind_mode sockets bind to it
+         * \pre None
+         * \post endpt is in the socket's connection (or binding) list
+         */
+        void add (const std::string &endpt)
+        {
+            add (endpt, Mode());
+        }
+
+        /*!
+         * \brief sends the message over the socket (see Socket::send())
+         * \pre The socket type can send (checked at compile time)
+         * \post as for Socket::send()
+         * \returns Whether the message was sent or queued
+         */
+        template <class T>
+        bool send (const BaseMessage<T> &msg, const int opts = 0)
+        {
+            static_assert (socket_traits<Type>::can_send, "this socket type can't send");
+            open (Mode());
+            return m_sock.do_send (msg, opts);
+        }
+        ///@{
+        /*!
+         * \brief sends a multipart message straight from caller-owned buffers (see Socket::sendv())
+         * \pre The socket type can send (checked at compile time)
+         * \post as for Socket::sendv()
+         * \returns Whether the message was sent or queued
+         */
+        bool sendv (const const_buffer *bufs, const size_t count, const int opts = 0)
+        {
+            static_assert (socket_traits<Type>::can_send, "this socket type can't send");
+            return m_sock.sendv (bufs, count, opts);
+        }
+        bool sendv (const std::vector<const_buffer> &bufs, const int opts = 0)
+        {
+            return sendv (bufs.data(), bufs.size(), opts);
+        }
+        ///@}
+
+        /*!
+         * \brief recv's the message over the socket (see Socket::recv())
+         * \pre The socket type can recv (checked at compile time)
+         * \post as for Socket::recv(); a single_part socket reads exactly one frame
+         * \returns Whether the recv was successful or not
+         */
+        template <class T>
+        bool recv (BaseMessage<T> &msg, const int opts = 0)
+        {
+            static_assert (socket_traits<Type>::can_recv, "this socket type can't recv");
+            open (Mode());
+            return m_sock.template do_recv<MULTI> (msg, opts);
+        }
+        /*!
+         * \brief recv's the message over the socket, reusing msg's frames (see Socket::recv_into())
+         * \pre The socket type can recv (checked at compile time)
+         * \post as for Socket::recv_into(); a single_part socket reads exactly one frame
+         * \returns Whether the recv was successful or not
+         */
+        template <class T>
+        bool recv_into (BaseMessage<T> &msg, const int opts = 0)
+        {
+            static_assert (socket_traits<Type>::can_recv, "this socket type can't recv");
+            open (Mode());
+            return m_sock.template do_recv_into<MULTI> (msg, opts);
+        }
+        /*!
+         * \brief recv's a message one frame at a time (see Socket::recv_frames())
+         * \pre The socket type can recv (checked at compile time)
+         * \post as for Socket::recv_frames(); a single_part socket hands fn exactly one frame
+         * \returns Whether the recv was successful or not
+         */
+        template <class F>
+        bool recv_frames (F fn, const int opts = 0)
+        {
+            static_assert (socket_traits<Type>::can_recv, "this socket type can't recv");
+            open (Mode());
+            return m_sock.template do_recv_frames<MULTI> (fn, opts);
+        }
+
+        /*!
+         * \brief subscribes to messages starting with prefix
+         * \pre The socket is a ZMQ_SUB (checked at compile time)
+         * \post the socket is created if it didn't exist yet, and the subscription applied to it right away
+         */
+        void subscribe (const std::string &prefix)
+        {
+            static_assert (Type == ZMQ_SUB, "only SUB sockets subscribe");
+            open (Mode());
+            m_sock.raw_sock().setsockopt (ZMQ_SUBSCRIBE, prefix.data(), prefix.size());
+        }
+        /*!
+         * \brief sets a sockopt (before connection; see Socket::setsockopt())
+         * \pre name and data are allowable values from the ZMQ API Spec
+         * \post the sockopt is set to be set on next connect
+         */
+        template <class T>
+        void setsockopt (const int name, const T &data)
+        {
+            m_sock.setsockopt (name, data);
+        }
+
+        /*!
+         * \brief the dynamic socket underneath, for everything this class doesn't wrap
+         * \pre None
+         * \post None
+         * \returns the Socket
+         */
+        Socket &socket()
+        {
+            return m_sock;
+        }
+    };
+}
@@ -23,7 +23,10 @@
 
 #ifndef __ZMQCPP_H
 #define __ZMQCPP_H
+#include "buffer_pool.h"
+#include "capture.h"
 #include "context.h"
+#include "shm.h"
 #include "socket.h"
 #include "messages/message.h"
 #endif
\ No newline at end of file